@@ -50,6 +50,10 @@
 SoftwareSerial SerialAT(2, 3);  // RX, TX
 #endif
 
+// Chips with internal buffering can size the RX buffer to the most they hand
+// over at once instead, which keeps the number of AT commands down
+// #define TINY_GSM_READ_AHEAD
+
 // Increase RX buffer to capture the entire response
 // Chips without internal buffering (A6/A7, ESP8266, M590)
 // need enough space in the buffer for the entire response
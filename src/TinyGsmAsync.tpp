@@ -0,0 +1,260 @@
+/**
+ * @file       TinyGsmAsync.tpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMASYNC_H_
+#define SRC_TINYGSMASYNC_H_
+
+#include "TinyGsmCommon.h"
+#include "TinyGsmMatcher.h"
+#include "TinyGsmModem.tpp"
+
+// The queue is only built in with TINY_GSM_ASYNC defined.  Without it the
+// drivers still derive from TinyGsmAsync, which is then empty and takes up
+// no RAM.
+#if defined(TINY_GSM_ASYNC)
+
+#define TINY_GSM_MODEM_HAS_ASYNC
+
+#if !defined(TINY_GSM_ASYNC_QUEUE_SIZE)
+#define TINY_GSM_ASYNC_QUEUE_SIZE 4
+#endif
+
+// The drivers' own GSM_OK and GSM_ERROR are only defined after this file is
+// included, so the default responses are kept here
+static const char GSM_ASYNC_OK[] TINY_GSM_PROGMEM    = "OK\r\n";
+static const char GSM_ASYNC_ERROR[] TINY_GSM_PROGMEM = "ERROR\r\n";
+// The +CME ERROR and +CMS ERROR that also end a command
+static const char GSM_ASYNC_CODE_ERROR[] TINY_GSM_PROGMEM = "ERROR:";
+
+// Called once a queued command finishes, with the 1-based index of the
+// response that came back or 0 if the command timed out.  Anything following
+// the response on the same line can still be read from the modem's stream.
+typedef void (*TinyGsmAsyncCallback)(int8_t result, void* context);
+
+template <class modemType>
+class TinyGsmAsync {
+ public:
+  /*
+   * Asynchronous AT commands
+   */
+  // Queues "AT" + cmd to be sent by poll().  Nothing is copied: a command kept
+  // in RAM must stay valid until its callback has been called.
+  // A command can finish on an intermediate line (such as "+CSQ:"); the OK or
+  // ERROR that ends it is then skipped before the next command is sent.
+  // Returns false if the queue is full.
+  bool queueAT(const __FlashStringHelper* cmd,
+               TinyGsmAsyncCallback callback = NULL,
+               void* context = NULL, uint32_t timeout_ms = 1000L,
+               GsmConstStr r1 = GFP(GSM_ASYNC_OK),
+               GsmConstStr r2 = GFP(GSM_ASYNC_ERROR),
+               GsmConstStr r3 = NULL) {
+    return queueImpl(reinterpret_cast<const char*>(cmd), true, callback,
+                     context, timeout_ms, r1, r2, r3);
+  }
+  bool queueAT(const char* cmd, TinyGsmAsyncCallback callback = NULL,
+               void* context = NULL, uint32_t timeout_ms = 1000L,
+               GsmConstStr r1 = GFP(GSM_ASYNC_OK),
+               GsmConstStr r2 = GFP(GSM_ASYNC_ERROR),
+               GsmConstStr r3 = NULL) {
+    return queueImpl(cmd, false, callback, context, timeout_ms, r1, r2, r3);
+  }
+
+  // Moves the queued commands along without blocking: sends the next command
+  // when the modem is free, reads whatever has already arrived and completes
+  // or times out the command in flight.  URC's are handled as they are seen,
+  // whether or not a command is waiting.  Call this from the main loop.
+  // Returns true while commands are still queued.
+  //
+  // Blocking calls must not be made while a command is queued, as both would
+  // be reading the same responses.
+  bool poll() {
+    if (!asyncSent && !asyncTrailing && asyncCount) { sendNext(); }
+
+    while (thisModem().stream.available() > 0) {
+      TINY_GSM_YIELD();
+      int8_t a = thisModem().stream.read();
+      if (a <= 0) continue;  // Skip 0x00 bytes, just in case
+      uint8_t hit = asyncMatcher.feed(a);
+      if (!hit) { continue; }
+      if (hit <= 3 && asyncTrailing) {
+        // The end of a command that has finished already
+        asyncTrailing = false;
+        watch(NULL);
+        continue;
+      }
+      if (hit <= 3) {
+        finish(hit);
+        // Leave the rest of the line to the callback
+        return asyncCount > 0;
+      }
+      // The rest of a URC is already on its way, so the handler may wait
+      // briefly for it
+      if (handleURC(modemType::urcTable()[hit - 4], asyncMatcher.line())) {
+        asyncMatcher.reset();
+      }
+    }
+
+    if (asyncTrailing && millis() - asyncStart >= asyncTimeout) {
+      asyncTrailing = false;
+      watch(NULL);
+    }
+    if (asyncSent && millis() - asyncStart >= asyncTimeout) { finish(0); }
+    return asyncCount > 0;
+  }
+
+  // Number of commands queued, including the one in flight
+  uint8_t pendingAT() const {
+    return asyncCount;
+  }
+
+  /*
+   * CRTP Helper
+   */
+ protected:
+  inline const modemType& thisModem() const {
+    return static_cast<const modemType&>(*this);
+  }
+  inline modemType& thisModem() {
+    return static_cast<modemType&>(*this);
+  }
+
+  /*
+   * Asynchronous AT commands
+   */
+ protected:
+  struct TinyGsmAsyncCmd {
+    const char*          cmd;
+    bool                 flash;
+    GsmConstStr          responses[3];
+    uint32_t             timeout;
+    TinyGsmAsyncCallback callback;
+    void*                context;
+  };
+
+  TinyGsmAsync()
+      : asyncHead(0),
+        asyncCount(0),
+        asyncSent(false),
+        asyncTrailing(false) {
+    watch(NULL);
+  }
+
+  bool queueImpl(const char* cmd, bool flash, TinyGsmAsyncCallback callback,
+                 void* context, uint32_t timeout_ms, GsmConstStr r1,
+                 GsmConstStr r2, GsmConstStr r3) {
+    if (asyncCount >= TINY_GSM_ASYNC_QUEUE_SIZE) { return false; }
+    TinyGsmAsyncCmd& c =
+        asyncQueue[(asyncHead + asyncCount) % TINY_GSM_ASYNC_QUEUE_SIZE];
+    c.cmd          = cmd;
+    c.flash        = flash;
+    c.responses[0] = r1;
+    c.responses[1] = r2;
+    c.responses[2] = r3;
+    c.timeout      = timeout_ms;
+    c.callback     = callback;
+    c.context      = context;
+    asyncCount++;
+    return true;
+  }
+
+  void sendNext() {
+    TinyGsmAsyncCmd& c = asyncQueue[asyncHead];
+    if (c.flash) {
+      thisModem().sendAT(reinterpret_cast<const __FlashStringHelper*>(c.cmd));
+    } else {
+      thisModem().sendAT(c.cmd);
+    }
+    watch(c.responses);
+    asyncSent    = true;
+    asyncStart   = millis();
+    asyncTimeout = c.timeout;
+  }
+
+  void finish(int8_t result) {
+    TinyGsmAsyncCmd c = asyncQueue[asyncHead];
+    asyncHead         = (asyncHead + 1) % TINY_GSM_ASYNC_QUEUE_SIZE;
+    asyncCount--;
+    asyncSent = false;
+    if (result && !isFinal(c.responses[result - 1])) {
+      // The modem still owes the OK or ERROR that ends the command, which
+      // would otherwise be taken as the next command's answer
+      static const GsmConstStr trailing[3] = {GFP(GSM_ASYNC_OK),
+                                              GFP(GSM_ASYNC_ERROR),
+                                              GFP(GSM_ASYNC_CODE_ERROR)};
+      watch(trailing);
+      asyncTrailing = true;
+      asyncStart    = millis();
+    } else {
+      watch(NULL);
+    }
+    if (c.callback) { c.callback(result, c.context); }
+  }
+
+  // Whether a response is the last line of a command: OK, or an error
+  static bool isFinal(GsmConstStr response) {
+    const char* r  = reinterpret_cast<const char*>(response);
+    const char* ok = GSM_ASYNC_OK;
+    size_t      i  = 0;
+    while (TINY_GSM_PGM_BYTE(r + i) &&
+           TINY_GSM_PGM_BYTE(r + i) == TINY_GSM_PGM_BYTE(ok + i)) {
+      i++;
+    }
+    if (!TINY_GSM_PGM_BYTE(r + i) && !TINY_GSM_PGM_BYTE(ok + i)) {
+      return true;
+    }
+    // Anything naming an ERROR
+    for (i = 0; TINY_GSM_PGM_BYTE(r + i); i++) {
+      if (TINY_GSM_PGM_BYTE(r + i) == 'E' &&
+          TINY_GSM_PGM_BYTE(r + i + 1) == 'R' &&
+          TINY_GSM_PGM_BYTE(r + i + 2) == 'R' &&
+          TINY_GSM_PGM_BYTE(r + i + 3) == 'O' &&
+          TINY_GSM_PGM_BYTE(r + i + 4) == 'R') {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Sets the matcher up for the given responses (or none) plus the URC's;
+  // the responses always take the first three slots
+  void watch(const GsmConstStr* responses) {
+    asyncMatcher.clear();
+    for (uint8_t i = 0; i < 3; i++) {
+      asyncMatcher.add(responses ? responses[i] : NULL);
+    }
+    for (uint8_t i = 0; modemType::urcTable()[i].prefix != NULL; i++) {
+      asyncMatcher.add(GFP(modemType::urcTable()[i].prefix));
+    }
+  }
+
+  // As in TinyGsmModem, the table may belong to a class derived from
+  // modemType
+  template <class T>
+  bool handleURC(const TinyGsmUrc<T>& urc, const char* line) {
+    return (static_cast<T&>(thisModem()).*urc.handler)(line, NULL);
+  }
+
+  TinyGsmAsyncCmd                       asyncQueue[TINY_GSM_ASYNC_QUEUE_SIZE];
+  TinyGsmMatcher<TINY_GSM_MATCHER_SIZE> asyncMatcher;
+  uint8_t                               asyncHead;
+  uint8_t                               asyncCount;
+  bool                                  asyncSent;
+  // Waiting out the OK or ERROR of a command that finished early
+  bool     asyncTrailing;
+  uint32_t asyncStart;
+  uint32_t asyncTimeout;
+};
+
+#else
+
+template <class modemType>
+class TinyGsmAsync {};
+
+#endif  // TINY_GSM_ASYNC
+
+#endif  // SRC_TINYGSMASYNC_H_
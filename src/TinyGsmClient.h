@@ -14,17 +14,20 @@
 typedef TinyGsmSim800                        TinyGsm;
 typedef TinyGsmSim800::GsmClientSim800       TinyGsmClient;
 typedef TinyGsmSim800::GsmClientSecureSim800 TinyGsmClientSecure;
+typedef TinyGsmSim800::GsmUDPSim800          TinyGsmClientUDP;
 
 #elif defined(TINY_GSM_MODEM_SIM808) || defined(TINY_GSM_MODEM_SIM868)
 #include "TinyGsmClientSIM808.h"
 typedef TinyGsmSim808                        TinyGsm;
 typedef TinyGsmSim808::GsmClientSim800       TinyGsmClient;
 typedef TinyGsmSim808::GsmClientSecureSim800 TinyGsmClientSecure;
+typedef TinyGsmSim808::GsmUDPSim800          TinyGsmClientUDP;
 
 #elif defined(TINY_GSM_MODEM_SIM900)
 #include "TinyGsmClientSIM800.h"
 typedef TinyGsmSim800                  TinyGsm;
 typedef TinyGsmSim800::GsmClientSim800 TinyGsmClient;
+typedef TinyGsmSim800::GsmUDPSim800    TinyGsmClientUDP;
 
 #elif defined(TINY_GSM_MODEM_SIM7000)
 #include "TinyGsmClientSIM7000.h"
@@ -43,6 +46,7 @@ typedef TinyGsmSim7000SSL::GsmClientSecureSIM7000SSL TinyGsmClientSecure;
 typedef TinyGsmSim7080                         TinyGsm;
 typedef TinyGsmSim7080::GsmClientSim7080       TinyGsmClient;
 typedef TinyGsmSim7080::GsmClientSecureSIM7080 TinyGsmClientSecure;
+typedef TinyGsmSim7080::GsmUDPSim7080          TinyGsmClientUDP;
 
 #elif defined(TINY_GSM_MODEM_SIM5320) || defined(TINY_GSM_MODEM_SIM5360) || \
     defined(TINY_GSM_MODEM_SIM5300) || defined(TINY_GSM_MODEM_SIM7100)
@@ -58,9 +62,11 @@ typedef TinyGsmSim7600::GsmClientSim7600 TinyGsmClient;
 
 #elif defined(TINY_GSM_MODEM_UBLOX)
 #include "TinyGsmClientUBLOX.h"
-typedef TinyGsmUBLOX                       TinyGsm;
-typedef TinyGsmUBLOX::GsmClientUBLOX       TinyGsmClient;
-typedef TinyGsmUBLOX::GsmClientSecureUBLOX TinyGsmClientSecure;
+typedef TinyGsmUBLOX                            TinyGsm;
+typedef TinyGsmUBLOX::GsmClientUBLOX            TinyGsmClient;
+typedef TinyGsmUBLOX::GsmClientSecureUBLOX      TinyGsmClientSecure;
+typedef TinyGsmUBLOX::GsmUDPUBLOX               TinyGsmClientUDP;
+typedef TinyGsmUBLOX::GsmClientTransparentUBLOX TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_SARAR4)
 #include "TinyGsmClientSaraR4.h"
@@ -75,8 +81,10 @@ typedef TinyGsmM95::GsmClientM95 TinyGsmClient;
 
 #elif defined(TINY_GSM_MODEM_BG96)
 #include "TinyGsmClientBG96.h"
-typedef TinyGsmBG96                TinyGsm;
-typedef TinyGsmBG96::GsmClientBG96 TinyGsmClient;
+typedef TinyGsmBG96                           TinyGsm;
+typedef TinyGsmBG96::GsmClientBG96            TinyGsmClient;
+typedef TinyGsmBG96::GsmUDPBG96               TinyGsmClientUDP;
+typedef TinyGsmBG96::GsmClientTransparentBG96 TinyGsmClientTransparent;
 
 #elif defined(TINY_GSM_MODEM_A6) || defined(TINY_GSM_MODEM_A7)
 #include "TinyGsmClientA6.h"
@@ -15,6 +15,7 @@
 #define TINY_GSM_MUX_COUNT 8
 #define TINY_GSM_NO_MODEM_BUFFER
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
 #include "TinyGsmCalling.tpp"
 #include "TinyGsmGPRS.tpp"
@@ -30,6 +31,8 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_CIPRCV[] TINY_GSM_PROGMEM    = "+CIPRCV:";
+static const char GSM_URC_TCPCLOSED[] TINY_GSM_PROGMEM = "+TCPCLOSED:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -42,6 +45,7 @@ enum RegStatus {
 };
 
 class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
+                  public TinyGsmAsync<TinyGsmA6>,
                   public TinyGsmGPRS<TinyGsmA6>,
                   public TinyGsmTCP<TinyGsmA6, TINY_GSM_MUX_COUNT>,
                   public TinyGsmCalling<TinyGsmA6>,
@@ -49,6 +53,7 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
                   public TinyGsmTime<TinyGsmA6>,
                   public TinyGsmBattery<TinyGsmA6> {
   friend class TinyGsmModem<TinyGsmA6>;
+  friend class TinyGsmAsync<TinyGsmA6>;
   friend class TinyGsmGPRS<TinyGsmA6>;
   friend class TinyGsmTCP<TinyGsmA6, TINY_GSM_MUX_COUNT>;
   friend class TinyGsmCalling<TinyGsmA6>;
@@ -73,6 +78,7 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
     bool init(TinyGsmA6* modem, uint8_t = 0) {
       this->at       = modem;
       this->mux      = -1;
+      sock_available = 0;
       sock_connected = false;
 
       return true;
@@ -94,6 +100,7 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       TINY_GSM_YIELD();
       at->sendAT(GF("+CIPCLOSE="), mux);
       sock_connected = false;
@@ -440,7 +447,7 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(2000L, GF(GSM_NL ">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(10000L, GFP(GSM_OK), GF(GSM_NL "FAIL")) != 1) { return 0; }
     return len;
@@ -458,7 +465,6 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -469,78 +475,13 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+CIPRCV:"))) {
-          int8_t  mux      = streamGetIntBefore(',');
-          int16_t len      = streamGetIntBefore(',');
-          int16_t len_orig = len;
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            if (len > sockets[mux]->rx.free()) {
-              DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
-            } else {
-              DBG("### Got: ", len, "->", sockets[mux]->rx.free());
-            }
-            while (len--) { moveCharFromStreamToFifo(mux); }
-            // TODO(?) Deal with missing characters
-            if (len_orig > sockets[mux]->available()) {
-              DBG("### Fewer characters received than expected: ",
-                  sockets[mux]->available(), " vs ", len_orig);
-            }
-          }
-          data = "";
-        } else if (data.endsWith(GF("+TCPCLOSED:"))) {
-          int8_t mux = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -553,8 +494,14 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -569,6 +516,53 @@ class TinyGsmA6 : public TinyGsmModem<TinyGsmA6>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmA6>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmA6> table[] = {
+        {GSM_URC_CIPRCV, &TinyGsmA6::handleCipRcv},
+        {GSM_URC_TCPCLOSED, &TinyGsmA6::handleTcpClosed},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +CIPRCV:
+  bool handleCipRcv(const char*, String*) {
+    int8_t  mux      = streamGetIntBefore(',');
+    int16_t len      = streamGetIntBefore(',');
+    int16_t len_orig = len;
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      if (len > sockets[mux]->rx.free()) {
+        DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
+      } else {
+        DBG("### Got: ", len, "->", sockets[mux]->rx.free());
+      }
+      while (len--) { moveCharFromStreamToFifo(mux); }
+      // TODO(?) Deal with missing characters
+      if (len_orig > sockets[mux]->available()) {
+        DBG("### Fewer characters received than expected: ",
+            sockets[mux]->available(), " vs ", len_orig);
+      }
+    }
+    return true;
+  }
+
+  // +TCPCLOSED:
+  bool handleTcpClosed(const char*, String*) {
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
  public:
   Stream& stream;
 
@@ -13,10 +13,21 @@
 // #define TINY_GSM_DEBUG Serial
 
 #define TINY_GSM_MUX_COUNT 12
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#define TINY_GSM_MODEM_HAS_CONNECT_ASYNC
+#define TINY_GSM_DATA_MODE_END "NO CARRIER"
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1500
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1460
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
 #include "TinyGsmCalling.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmGPS.tpp"
 #include "TinyGsmModem.tpp"
@@ -24,6 +35,8 @@
 #include "TinyGsmTCP.tpp"
 #include "TinyGsmTemperature.tpp"
 #include "TinyGsmTime.tpp"
+#include "TinyGsmTransparent.tpp"
+#include "TinyGsmUDP.tpp"
 #include "TinyGsmNTP.tpp"
 
 #define GSM_NL "\r\n"
@@ -33,6 +46,8 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_QIURC[] TINY_GSM_PROGMEM  = GSM_NL "+QIURC:";
+static const char GSM_URC_QIOPEN[] TINY_GSM_PROGMEM = GSM_NL "+QIOPEN:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -45,8 +60,12 @@ enum RegStatus {
 };
 
 class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
+                    public TinyGsmAsync<TinyGsmBG96>,
                     public TinyGsmGPRS<TinyGsmBG96>,
                     public TinyGsmTCP<TinyGsmBG96, TINY_GSM_MUX_COUNT>,
+                    public TinyGsmDNS<TinyGsmBG96>,
+                    public TinyGsmUDP<TinyGsmBG96, TINY_GSM_MUX_COUNT>,
+                    public TinyGsmTransparent<TinyGsmBG96, TINY_GSM_MUX_COUNT>,
                     public TinyGsmCalling<TinyGsmBG96>,
                     public TinyGsmSMS<TinyGsmBG96>,
                     public TinyGsmTime<TinyGsmBG96>,
@@ -55,8 +74,12 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
                     public TinyGsmBattery<TinyGsmBG96>,
                     public TinyGsmTemperature<TinyGsmBG96> {
   friend class TinyGsmModem<TinyGsmBG96>;
+  friend class TinyGsmAsync<TinyGsmBG96>;
   friend class TinyGsmGPRS<TinyGsmBG96>;
   friend class TinyGsmTCP<TinyGsmBG96, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmBG96>;
+  friend class TinyGsmUDP<TinyGsmBG96, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmTransparent<TinyGsmBG96, TINY_GSM_MUX_COUNT>;
   friend class TinyGsmCalling<TinyGsmBG96>;
   friend class TinyGsmSMS<TinyGsmBG96>;
   friend class TinyGsmTime<TinyGsmBG96>;
@@ -106,7 +129,21 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
     }
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
+    // Starts opening the connection and returns without waiting for it, so
+    // several clients can connect at the same time.  connecting() stays true
+    // until the modem reports back.
+    // Returns false if the modem refused to start.
+    bool connectAsync(const char* host, uint16_t port, int timeout_s = 75) {
+      stop();
+      TINY_GSM_YIELD();
+      rx.clear();
+      startConnect(timeout_s);
+      return connectStarted(
+          at->modemConnect(host, port, mux, false, timeout_s, true));
+    }
+
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       uint32_t startMillis = millis();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+QICLOSE="), mux);
@@ -151,6 +188,18 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
   };
   */
 
+  /*
+   * Inner UDP Socket
+   */
+ public:
+  typedef GsmUDP<GsmClientBG96> GsmUDPBG96;
+
+  /*
+   * Inner Transparent Client
+   */
+ public:
+  typedef GsmClientTransparent<GsmClientBG96> GsmClientTransparentBG96;
+
   /*
    * Constructor
    */
@@ -525,40 +574,140 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
     return res;
   }
 
+  /*
+   * DNS functions
+   */
+ protected:
+  // The addresses come in "dnsgip" URC's, which handleQiurc() picks up
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    dnsAnswer = "";
+    dnsDone   = false;
+    sendAT(GF("+QIDNSGIP=1,\""), host, '"');
+    if (waitResponse() == 1) {
+      uint32_t startMillis = millis();
+      while (!dnsDone && millis() - startMillis < timeout_ms) {
+        waitResponse(15, NULL, NULL);
+      }
+    }
+    dnsDone = true;
+    return dnsAnswer;
+  }
+
   /*
    * Client related functions
    */
  protected:
+  // With async set, returns once the modem has taken the command and leaves
+  // the +QIOPEN to the URC handler
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
-                    bool ssl = false, int timeout_s = 150) {
+                    bool ssl = false, int timeout_s = 150,
+                    bool async = false) {
     if (ssl) { DBG("SSL not yet supported on this module!"); }
 
     uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
 
+    // A host looked up before goes by its address
+    String addr = dnsConnectHost(host, timeout_ms, async);
+
     // <PDPcontextID>(1-16), <connectID>(0-11),
     // "TCP/UDP/TCP LISTENER/UDPSERVICE", "<IP_address>/<domain_name>",
     // <remote_port>,<local_port>,<access_mode>(0-2; 0=buffer)
-    sendAT(GF("+QIOPEN=1,"), mux, GF(",\""), GF("TCP"), GF("\",\""), host,
+    sendAT(GF("+QIOPEN=1,"), mux, GF(",\""), GF("TCP"), GF("\",\""), addr,
            GF("\","), port, GF(",0,0"));
-    waitResponse();
+    int8_t rsp = waitResponse();
+    if (async) { return dnsConnectStarted(host, mux, rsp == 1); }
 
     if (waitResponse(timeout_ms, GF(GSM_NL "+QIOPEN:")) != 1) { return false; }
 
     if (streamGetIntBefore(',') != mux) { return false; }
     // Read status
-    return (0 == streamGetIntBefore('\n'));
+    if (streamGetIntBefore('\n') != 0) {
+      // In case the host has moved
+      clearDnsCache(host);
+      return false;
+    }
+    return true;
   }
 
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+QISEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "SEND OK")) != 1) { return 0; }
     // TODO(?): Wait for ACK? AT+QISEND=id,0
     return len;
   }
 
+  // Opens the socket in transparent access mode, after which the modem
+  // answers CONNECT and the line carries the connection's data
+  bool modemConnectTransparent(const char* host, uint16_t port, uint8_t* mux,
+                               int timeout_s = 150) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    String   addr       = dnsConnectHost(host, timeout_ms);
+    sendAT(GF("+QIOPEN=1,"), *mux, GF(",\"TCP\",\""), addr, GF("\","), port,
+           GF(",0,2"));
+    int8_t rsp = waitResponse(timeout_ms, GF(GSM_NL "CONNECT"), GF("ERROR"),
+                              GF(GSM_NL "+QIOPEN:"));
+    // The data starts after the end of the line
+    streamSkipUntil('\n');
+    return rsp == 1;
+  }
+
+  // Takes an open socket back to transparent mode after a "+++"
+  bool modemEnterDataMode(uint8_t mux) {
+    sendAT(GF("+QISWTMD="), mux, GF(",2"));
+    if (waitResponse(10000L, GF(GSM_NL "CONNECT"), GF("ERROR")) != 1) {
+      return false;
+    }
+    streamSkipUntil('\n');
+    return true;
+  }
+
+  // A "UDP SERVICE" socket sends to and hears from any address
+  bool modemOpenUdp(const char*, uint16_t, uint16_t localPort, uint8_t* mux) {
+    sendAT(GF("+QIOPEN=1,"), *mux, GF(",\"UDP SERVICE\",\"127.0.0.1\",0,"),
+           localPort, GF(",0"));
+    if (waitResponse() != 1) { return false; }
+    if (waitResponse(150000L, GF(GSM_NL "+QIOPEN:")) != 1) { return false; }
+    if (streamGetIntBefore(',') != *mux) { return false; }
+    return (0 == streamGetIntBefore('\n'));
+  }
+
+  // The modem only sends to an address, so a name is looked up (or found in
+  // the cache) first
+  int16_t modemSendTo(const char* host, uint16_t port, const void* buff,
+                      size_t len, uint8_t mux) {
+    uint32_t timeout_ms = TINY_GSM_DNS_TIMEOUT;
+    String   addr       = dnsConnectHost(host, timeout_ms);
+    sendAT(GF("+QISEND="), mux, ',', (uint16_t)len, GF(",\""), addr,
+           GF("\","), port);
+    if (waitResponse(GF(">")) != 1) { return 0; }
+    streamWritePayload(buff, len);
+    stream.flush();
+    if (waitResponse(GF(GSM_NL "SEND OK")) != 1) { return 0; }
+    return len;
+  }
+
+  // Each read of a "UDP SERVICE" socket gives one datagram and its sender
+  size_t modemReadFrom(size_t size, uint8_t mux, IPAddress* ip,
+                       uint16_t* port) {
+    if (!sockets[mux]) return 0;
+    sendAT(GF("+QIRD="), mux, ',', (uint16_t)size);
+    // +QIRD: <len>,"<remote ip>",<remote port>
+    if (waitResponse(GF("+QIRD:")) != 1) { return 0; }
+    int16_t len = streamGetIntBefore(',');
+    streamSkipUntil('"');
+    ip->fromString(stream.readStringUntil('"'));
+    streamSkipUntil(',');
+    *port = streamGetIntBefore('\n');
+
+    if (len > 0) { moveCharsFromStreamToFifo(mux, len); }
+    waitResponse();
+    sockets[mux]->sock_available = modemGetAvailable(mux);
+    return len > 0 ? len : 0;
+  }
+
   size_t modemRead(size_t size, uint8_t mux) {
     if (!sockets[mux]) return 0;
     sendAT(GF("+QIRD="), mux, ',', (uint16_t)size);
@@ -574,6 +723,14 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
 
   size_t modemGetAvailable(uint8_t mux) {
     if (!sockets[mux]) return 0;
+    size_t result = modemGetBuffered(mux);
+    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
+    return result;
+  }
+
+  // How much data the modem holds for the socket, without checking that it is
+  // still connected
+  size_t modemGetBuffered(uint8_t mux) {
     sendAT(GF("+QIRD="), mux, GF(",0"));
     size_t result = 0;
     if (waitResponse(GF("+QIRD:")) == 1) {
@@ -583,10 +740,32 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
       if (result) { DBG("### DATA AVAILABLE:", result, "on", mux); }
       waitResponse();
     }
-    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
     return result;
   }
 
+  // There is no command for the data held on all sockets, but one +QISTATE?
+  // gives the state of them all, so the sockets found empty are checked
+  // together
+  void modemRefreshSockets() {
+    int8_t  emptyMux = -1;
+    uint8_t empty    = 0;
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      GsmClientBG96* sock = sockets[mux];
+      if (!sock || !sock->got_data) { continue; }
+      sock->got_data       = false;
+      sock->sock_available = modemGetBuffered(mux);
+      if (!sock->sock_available) {
+        emptyMux = mux;
+        empty++;
+      }
+    }
+    if (empty == 1) {
+      sockets[emptyMux]->sock_connected = modemGetConnected(emptyMux);
+    } else if (empty > 1) {
+      modemGetConnectedAll();
+    }
+  }
+
   bool modemGetConnected(uint8_t mux) {
     sendAT(GF("+QISTATE=1,"), mux);
     // +QISTATE: 0,"TCP","151.139.237.11",80,5087,4,1,0,0,"uart1"
@@ -606,11 +785,37 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
     return 2 == res;
   }
 
+  // Updates sock_connected of every socket from one +QISTATE?, which lists
+  // the sockets that are open, a line each; the rest are closed
+  void modemGetConnectedAll() {
+    sendAT(GF("+QISTATE?"));
+    uint32_t connected = 0;
+    int8_t   res;
+    while ((res = waitResponse(GF("+QISTATE:"), GFP(GSM_OK),
+                               GFP(GSM_ERROR))) == 1) {
+      int8_t mux = streamGetIntBefore(',');
+      streamSkipUntil(',');  // Skip socket type
+      streamSkipUntil(',');  // Skip remote ip
+      streamSkipUntil(',');  // Skip remote port
+      streamSkipUntil(',');  // Skip local port
+      if (streamGetIntBefore(',') == 2 && mux >= 0 &&
+          mux < TINY_GSM_MUX_COUNT) {
+        connected |= 1UL << mux;
+      }
+      streamSkipUntil('\n');
+    }
+    if (res != 2) { return; }
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      if (sockets[mux]) {
+        sockets[mux]->sock_connected = connected & (1UL << mux);
+      }
+    }
+  }
+
   /*
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -621,73 +826,13 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+QIURC:"))) {
-          streamSkipUntil('\"');
-          String urc = stream.readStringUntil('\"');
-          streamSkipUntil(',');
-          if (urc == "recv") {
-            int8_t mux = streamGetIntBefore('\n');
-            DBG("### URC RECV:", mux);
-            if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
-            }
-          } else if (urc == "closed") {
-            int8_t mux = streamGetIntBefore('\n');
-            DBG("### URC CLOSE:", mux);
-            if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->sock_connected = false;
-            }
-          } else {
-            streamSkipUntil('\n');
-          }
-          data = "";
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -700,8 +845,14 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -716,12 +867,77 @@ class TinyGsmBG96 : public TinyGsmModem<TinyGsmBG96>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmBG96>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmBG96> table[] = {
+        {GSM_URC_QIURC, &TinyGsmBG96::handleQiurc},
+        {GSM_URC_QIOPEN, &TinyGsmBG96::handleQiopen},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +QIURC:
+  bool handleQiurc(const char*, String*) {
+    streamSkipUntil('\"');
+    String urc = stream.readStringUntil('\"');
+    streamSkipUntil(',');
+    if (urc == "recv") {
+      int8_t mux = streamGetIntBefore('\n');
+      DBG("### URC RECV:", mux);
+      if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+        sockets[mux]->got_data = true;
+      }
+    } else if (urc == "closed") {
+      int8_t mux = streamGetIntBefore('\n');
+      DBG("### URC CLOSE:", mux);
+      if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+        sockets[mux]->sock_connected = false;
+      }
+    } else if (urc == "dnsgip") {
+      // "dnsgip",<err>,<IP_count>,<DNS_ttl> is followed by "dnsgip","<IP>"
+      // for each address, of which the first is kept
+      String res = stream.readStringUntil('\n');
+      res.trim();
+      if (dnsDone) { return true; }
+      if (res.charAt(0) == '"') {
+        dnsAnswer = res.substring(1, res.length() - 1);
+        dnsDone   = true;
+      } else if (res.toInt() != 0 ||
+                 res.substring(res.indexOf(',') + 1).toInt() == 0) {
+        DBG("### DNS lookup failed:", res);
+        dnsDone = true;
+      }
+    } else {
+      streamSkipUntil('\n');
+    }
+    return true;
+  }
+
+  // +QIOPEN: <connectID>,<err>, after a connectAsync()
+  bool handleQiopen(const char*, String*) {
+    int8_t mux = streamGetIntBefore(',');
+    int    err = streamGetIntBefore('\n');
+    connectFinished(mux, err == 0);
+    dnsConnectFinished(mux, err == 0);
+    return true;
+  }
+
  public:
   Stream& stream;
 
  protected:
   GsmClientBG96* sockets[TINY_GSM_MUX_COUNT];
   const char*    gsmNL = GSM_NL;
+  // For the "dnsgip" URC's
+  String dnsAnswer;
+  bool   dnsDone = true;
 };
 
 #endif  // SRC_TINYGSMCLIENTBG96_H_
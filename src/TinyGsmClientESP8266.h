@@ -14,7 +14,11 @@
 
 #define TINY_GSM_MUX_COUNT 5
 #define TINY_GSM_NO_MODEM_BUFFER
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 2048
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmModem.tpp"
 #include "TinyGsmSSL.tpp"
 #include "TinyGsmTCP.tpp"
@@ -23,6 +27,8 @@
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM    = "OK" GSM_NL;
 static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
+static const char GSM_URC_IPD[] TINY_GSM_PROGMEM    = "+IPD,";
+static const char GSM_URC_CLOSED[] TINY_GSM_PROGMEM = "CLOSED";
 static uint8_t    TINY_GSM_TCP_KEEP_ALIVE      = 120;
 
 // <stat> status of ESP8266 station interface
@@ -39,10 +45,12 @@ enum RegStatus {
 };
 
 class TinyGsmESP8266 : public TinyGsmModem<TinyGsmESP8266>,
+                       public TinyGsmAsync<TinyGsmESP8266>,
                        public TinyGsmWifi<TinyGsmESP8266>,
                        public TinyGsmTCP<TinyGsmESP8266, TINY_GSM_MUX_COUNT>,
                        public TinyGsmSSL<TinyGsmESP8266> {
   friend class TinyGsmModem<TinyGsmESP8266>;
+  friend class TinyGsmAsync<TinyGsmESP8266>;
   friend class TinyGsmWifi<TinyGsmESP8266>;
   friend class TinyGsmTCP<TinyGsmESP8266, TINY_GSM_MUX_COUNT>;
   friend class TinyGsmSSL<TinyGsmESP8266>;
@@ -63,6 +71,7 @@ class TinyGsmESP8266 : public TinyGsmModem<TinyGsmESP8266>,
 
     bool init(TinyGsmESP8266* modem, uint8_t mux = 0) {
       this->at       = modem;
+      sock_available = 0;
       sock_connected = false;
 
       if (mux < TINY_GSM_MUX_COUNT) {
@@ -86,6 +95,7 @@ class TinyGsmESP8266 : public TinyGsmModem<TinyGsmESP8266>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       TINY_GSM_YIELD();
       at->sendAT(GF("+CIPCLOSE="), mux);
       sock_connected = false;
@@ -335,7 +345,7 @@ class TinyGsmESP8266 : public TinyGsmModem<TinyGsmESP8266>,
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(10000L, GF(GSM_NL "SEND OK" GSM_NL)) != 1) { return 0; }
     return len;
@@ -382,90 +392,19 @@ class TinyGsmESP8266 : public TinyGsmModem<TinyGsmESP8266>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR), GsmConstStr r3 = NULL,
                       GsmConstStr r4 = NULL, GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+IPD,"))) {
-          int8_t  mux      = streamGetIntBefore(',');
-          int16_t len      = streamGetIntBefore(':');
-          int16_t len_orig = len;
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            if (len > sockets[mux]->rx.free()) {
-              DBG("### Buffer overflow: ", len, "received vs",
-                  sockets[mux]->rx.free(), "available");
-            } else {
-              // DBG("### Got Data: ", len, "on", mux);
-            }
-            while (len--) { moveCharFromStreamToFifo(mux); }
-            // TODO(SRGDamia1): deal with buffer overflow/missed characters
-            if (len_orig > sockets[mux]->available()) {
-              DBG("### Fewer characters received than expected: ",
-                  sockets[mux]->available(), " vs ", len_orig);
-            }
-          }
-          data = "";
-        } else if (data.endsWith(GF("CLOSED"))) {
-          int8_t muxStart =
-              TinyGsmMax(0, data.lastIndexOf(GSM_NL, data.length() - 8));
-          int8_t coma = data.indexOf(',', muxStart);
-          int8_t mux  = data.substring(muxStart, coma).toInt();
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
-    }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
-    return index;
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, &data, responses, 5);
   }
 
   int8_t waitResponse(uint32_t timeout_ms, GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR), GsmConstStr r3 = NULL,
                       GsmConstStr r4 = NULL, GsmConstStr r5 = NULL) {
-    String data;
-    return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -474,6 +413,54 @@ class TinyGsmESP8266 : public TinyGsmModem<TinyGsmESP8266>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmESP8266>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmESP8266> table[] = {
+        {GSM_URC_IPD, &TinyGsmESP8266::handleIpd},
+        {GSM_URC_CLOSED, &TinyGsmESP8266::handleClosed},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +IPD,
+  bool handleIpd(const char*, String*) {
+    int8_t  mux      = streamGetIntBefore(',');
+    int16_t len      = streamGetIntBefore(':');
+    int16_t len_orig = len;
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      if (len > sockets[mux]->rx.free()) {
+        DBG("### Buffer overflow: ", len, "received vs",
+            sockets[mux]->rx.free(), "available");
+      } else {
+        // DBG("### Got Data: ", len, "on", mux);
+      }
+      while (len--) { moveCharFromStreamToFifo(mux); }
+      // TODO(SRGDamia1): deal with buffer overflow/missed characters
+      if (len_orig > sockets[mux]->available()) {
+        DBG("### Fewer characters received than expected: ",
+            sockets[mux]->available(), " vs ", len_orig);
+      }
+    }
+    return true;
+  }
+
+  // CLOSED
+  bool handleClosed(const char* line, String*) {
+    int8_t mux = atoi(line);
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
  public:
   Stream& stream;
 
@@ -15,6 +15,8 @@
 #define TINY_GSM_MUX_COUNT 2
 #define TINY_GSM_NO_MODEM_BUFFER
 
+#include "TinyGsmAsync.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmModem.tpp"
 #include "TinyGsmSMS.tpp"
@@ -28,6 +30,8 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_TCPRECV[] TINY_GSM_PROGMEM  = "+TCPRECV:";
+static const char GSM_URC_TCPCLOSE[] TINY_GSM_PROGMEM = "+TCPCLOSE:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -40,13 +44,17 @@ enum RegStatus {
 };
 
 class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
+                    public TinyGsmAsync<TinyGsmM590>,
                     public TinyGsmGPRS<TinyGsmM590>,
                     public TinyGsmTCP<TinyGsmM590, TINY_GSM_MUX_COUNT>,
+                    public TinyGsmDNS<TinyGsmM590>,
                     public TinyGsmSMS<TinyGsmM590>,
                     public TinyGsmTime<TinyGsmM590> {
   friend class TinyGsmModem<TinyGsmM590>;
+  friend class TinyGsmAsync<TinyGsmM590>;
   friend class TinyGsmGPRS<TinyGsmM590>;
   friend class TinyGsmTCP<TinyGsmM590, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmM590>;
   friend class TinyGsmSMS<TinyGsmM590>;
   friend class TinyGsmTime<TinyGsmM590>;
 
@@ -66,6 +74,7 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
 
     bool init(TinyGsmM590* modem, uint8_t mux = 0) {
       this->at       = modem;
+      sock_available = 0;
       sock_connected = false;
 
       if (mux < TINY_GSM_MUX_COUNT) {
@@ -89,6 +98,7 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       TINY_GSM_YIELD();
       at->sendAT(GF("+TCPCLOSE="), mux);
       sock_connected = false;
@@ -301,7 +311,8 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
                     int timeout_s = 75) {
     uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
     for (int i = 0; i < 3; i++) {  // TODO(?): no need for loop?
-      String ip = dnsIpQuery(host);
+      // The modem only takes an address, which is looked up once and cached
+      String ip = dnsConnectHost(host, timeout_ms);
 
       sendAT(GF("+TCPSETUP="), mux, GF(","), ip, GF(","), port);
       int8_t rsp = waitResponse(timeout_ms, GF(",OK" GSM_NL),
@@ -309,7 +320,10 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
                                 GF("+TCPSETUP:Error" GSM_NL));
       if (1 == rsp) {
         return true;
-      } else if (3 == rsp) {
+      }
+      // In case the host has moved
+      clearDnsCache(host);
+      if (3 == rsp) {
         sendAT(GF("+TCPCLOSE="), mux);
         waitResponse();
       }
@@ -321,7 +335,7 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+TCPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.write(static_cast<char>(0x0D));
     stream.flush();
     if (waitResponse(30000L, GF(GSM_NL "+TCPSEND:")) != 1) { return 0; }
@@ -337,9 +351,13 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
     return 1 == res;
   }
 
-  String dnsIpQuery(const char* host) {
+  /*
+   * DNS functions
+   */
+ protected:
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
     sendAT(GF("+DNS=\""), host, GF("\""));
-    if (waitResponse(10000L, GF(GSM_NL "+DNS:")) != 1) { return ""; }
+    if (waitResponse(timeout_ms, GF(GSM_NL "+DNS:")) != 1) { return ""; }
     String res = stream.readStringUntil('\n');
     waitResponse(GF("+DNS:OK" GSM_NL));
     res.trim();
@@ -350,7 +368,6 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -361,79 +378,13 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+TCPRECV:"))) {
-          int8_t  mux      = streamGetIntBefore(',');
-          int16_t len      = streamGetIntBefore(',');
-          int16_t len_orig = len;
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            if (len > sockets[mux]->rx.free()) {
-              DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
-            } else {
-              DBG("### Got: ", len, "->", sockets[mux]->rx.free());
-            }
-            while (len--) { moveCharFromStreamToFifo(mux); }
-            // TODO(?): Handle lost characters
-            if (len_orig > sockets[mux]->available()) {
-              DBG("### Fewer characters received than expected: ",
-                  sockets[mux]->available(), " vs ", len_orig);
-            }
-          }
-          data = "";
-        } else if (data.endsWith(GF("+TCPCLOSE:"))) {
-          int8_t mux = streamGetIntBefore(',');
-          streamSkipUntil('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -446,8 +397,14 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -462,6 +419,54 @@ class TinyGsmM590 : public TinyGsmModem<TinyGsmM590>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmM590>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmM590> table[] = {
+        {GSM_URC_TCPRECV, &TinyGsmM590::handleTcpRecv},
+        {GSM_URC_TCPCLOSE, &TinyGsmM590::handleTcpClose},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +TCPRECV:
+  bool handleTcpRecv(const char*, String*) {
+    int8_t  mux      = streamGetIntBefore(',');
+    int16_t len      = streamGetIntBefore(',');
+    int16_t len_orig = len;
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      if (len > sockets[mux]->rx.free()) {
+        DBG("### Buffer overflow: ", len, "->", sockets[mux]->rx.free());
+      } else {
+        DBG("### Got: ", len, "->", sockets[mux]->rx.free());
+      }
+      while (len--) { moveCharFromStreamToFifo(mux); }
+      // TODO(?): Handle lost characters
+      if (len_orig > sockets[mux]->available()) {
+        DBG("### Fewer characters received than expected: ",
+            sockets[mux]->available(), " vs ", len_orig);
+      }
+    }
+    return true;
+  }
+
+  // +TCPCLOSE:
+  bool handleTcpClose(const char*, String*) {
+    int8_t mux = streamGetIntBefore(',');
+    streamSkipUntil('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
  public:
   Stream& stream;
 
@@ -14,10 +14,19 @@
 // #define TINY_GSM_DEBUG Serial
 
 #define TINY_GSM_MUX_COUNT 6
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_NO_CHECK
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1500
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1460
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
 #include "TinyGsmCalling.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmModem.tpp"
 #include "TinyGsmSMS.tpp"
@@ -32,6 +41,9 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_QIRDI[] TINY_GSM_PROGMEM  = GSM_NL "+QIRDI:";
+static const char GSM_URC_CLOSED[] TINY_GSM_PROGMEM = "CLOSED" GSM_NL;
+static const char GSM_URC_QNITZ[] TINY_GSM_PROGMEM  = "+QNITZ:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -44,16 +56,20 @@ enum RegStatus {
 };
 
 class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
+                   public TinyGsmAsync<TinyGsmM95>,
                    public TinyGsmGPRS<TinyGsmM95>,
                    public TinyGsmTCP<TinyGsmM95, TINY_GSM_MUX_COUNT>,
+                   public TinyGsmDNS<TinyGsmM95>,
                    public TinyGsmCalling<TinyGsmM95>,
                    public TinyGsmSMS<TinyGsmM95>,
                    public TinyGsmTime<TinyGsmM95>,
                    public TinyGsmBattery<TinyGsmM95>,
                    public TinyGsmTemperature<TinyGsmM95> {
   friend class TinyGsmModem<TinyGsmM95>;
+  friend class TinyGsmAsync<TinyGsmM95>;
   friend class TinyGsmGPRS<TinyGsmM95>;
   friend class TinyGsmTCP<TinyGsmM95, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmM95>;
   friend class TinyGsmCalling<TinyGsmM95>;
   friend class TinyGsmSMS<TinyGsmM95>;
   friend class TinyGsmTime<TinyGsmM95>;
@@ -100,6 +116,7 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       uint32_t startMillis = millis();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+QICLOSE="), mux);
@@ -405,6 +422,24 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
     return temp;
   }
 
+  /*
+   * DNS functions
+   */
+ protected:
+  // The address follows the OK on a line of its own, so the wait is for the
+  // first dot in it
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    sendAT(GF("+QIDNSGIP=\""), host, '"');
+    if (waitResponse() != 1) { return ""; }
+    String res;
+    if (waitResponse(timeout_ms, res, GF("."), GFP(GSM_ERROR)) != 1) {
+      return "";
+    }
+    res += stream.readStringUntil('\n');
+    res.trim();
+    return res;
+  }
+
   /*
    * Client related functions
    */
@@ -412,19 +447,23 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
                     bool ssl = false, int timeout_s = 75) {
     if (ssl) { DBG("SSL not yet supported on this module!"); }
+    // A host looked up before goes by its address
     uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
-    sendAT(GF("+QIOPEN="), mux, GF(",\""), GF("TCP"), GF("\",\""), host,
+    String   addr       = dnsConnectHost(host, timeout_ms);
+    sendAT(GF("+QIOPEN="), mux, GF(",\""), GF("TCP"), GF("\",\""), addr,
            GF("\","), port);
     int8_t rsp = waitResponse(timeout_ms, GF("CONNECT OK" GSM_NL),
                               GF("CONNECT FAIL" GSM_NL),
                               GF("ALREADY CONNECT" GSM_NL));
+    // In case the host has moved
+    if (rsp != 1) { clearDnsCache(host); }
     return (1 == rsp);
   }
 
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+QISEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "SEND OK")) != 1) { return 0; }
 
@@ -515,7 +554,6 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -526,77 +564,13 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+QIRDI:"))) {
-          streamSkipUntil(',');  // Skip the context
-          streamSkipUntil(',');  // Skip the role
-          int8_t mux = streamGetIntBefore('\n');
-          // DBG("### Got Data:", mux);
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            // We have no way of knowing how much data actually came in, so
-            // we set the value to 1500, the maximum possible size.
-            sockets[mux]->sock_available = 1500;
-          }
-          data = "";
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int8_t nl   = data.lastIndexOf(GSM_NL, data.length() - 8);
-          int8_t coma = data.indexOf(',', nl + 2);
-          int8_t mux  = data.substring(nl + 2, coma).toInt();
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("+QNITZ:"))) {
-          streamSkipUntil('\n');  // URC for time sync
-          data = "";
-          DBG("### Network time updated.");
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -609,8 +583,14 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -625,6 +605,54 @@ class TinyGsmM95 : public TinyGsmModem<TinyGsmM95>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmM95>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmM95> table[] = {
+        {GSM_URC_QIRDI, &TinyGsmM95::handleQirdi},
+        {GSM_URC_CLOSED, &TinyGsmM95::handleClosed},
+        {GSM_URC_QNITZ, &TinyGsmM95::handleQnitz},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +QIRDI:
+  bool handleQirdi(const char*, String*) {
+    streamSkipUntil(',');  // Skip the context
+    streamSkipUntil(',');  // Skip the role
+    int8_t mux = streamGetIntBefore('\n');
+    // DBG("### Got Data:", mux);
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      // We have no way of knowing how much data actually came in, so
+      // we set the value to 1500, the maximum possible size.
+      sockets[mux]->sock_available = 1500;
+    }
+    return true;
+  }
+
+  // CLOSED
+  bool handleClosed(const char* line, String*) {
+    int8_t mux = atoi(line);
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
+  // +QNITZ:
+  bool handleQnitz(const char*, String*) {
+    streamSkipUntil('\n');  // URC for time sync
+    DBG("### Network time updated.");
+    return true;
+  }
+
  public:
   Stream& stream;
 
@@ -16,10 +16,19 @@
 // #define TINY_GSM_DEBUG Serial
 
 #define TINY_GSM_MUX_COUNT 6
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_NO_CHECK
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1500
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1460
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
 #include "TinyGsmCalling.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmModem.tpp"
 #include "TinyGsmSMS.tpp"
@@ -33,6 +42,9 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_QIRDI[] TINY_GSM_PROGMEM  = GSM_NL "+QIRDI:";
+static const char GSM_URC_CLOSED[] TINY_GSM_PROGMEM = "CLOSED" GSM_NL;
+static const char GSM_URC_QNITZ[] TINY_GSM_PROGMEM  = "+QNITZ:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -45,15 +57,19 @@ enum RegStatus {
 };
 
 class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
+                    public TinyGsmAsync<TinyGsmMC60>,
                     public TinyGsmGPRS<TinyGsmMC60>,
                     public TinyGsmTCP<TinyGsmMC60, TINY_GSM_MUX_COUNT>,
+                    public TinyGsmDNS<TinyGsmMC60>,
                     public TinyGsmCalling<TinyGsmMC60>,
                     public TinyGsmSMS<TinyGsmMC60>,
                     public TinyGsmTime<TinyGsmMC60>,
                     public TinyGsmBattery<TinyGsmMC60> {
   friend class TinyGsmModem<TinyGsmMC60>;
+  friend class TinyGsmAsync<TinyGsmMC60>;
   friend class TinyGsmGPRS<TinyGsmMC60>;
   friend class TinyGsmTCP<TinyGsmMC60, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmMC60>;
   friend class TinyGsmCalling<TinyGsmMC60>;
   friend class TinyGsmSMS<TinyGsmMC60>;
   friend class TinyGsmTime<TinyGsmMC60>;
@@ -99,6 +115,7 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       uint32_t startMillis = millis();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+QICLOSE="), mux);
@@ -369,6 +386,24 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
    */
   // Can follow battery functions as in the template
 
+  /*
+   * DNS functions
+   */
+ protected:
+  // The address follows the OK on a line of its own, so the wait is for the
+  // first dot in it
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    sendAT(GF("+QIDNSGIP=\""), host, '"');
+    if (waitResponse() != 1) { return ""; }
+    String res;
+    if (waitResponse(timeout_ms, res, GF("."), GFP(GSM_ERROR)) != 1) {
+      return "";
+    }
+    res += stream.readStringUntil('\n');
+    res.trim();
+    return res;
+  }
+
   /*
    * Client related functions
    */
@@ -377,27 +412,30 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
                     bool ssl = false, int timeout_s = 75) {
     if (ssl) { DBG("SSL not yet supported on this module!"); }
 
+    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    // A host looked up before goes by its address
+    String addr = dnsConnectHost(host, timeout_ms);
+
     // By default, MC60 expects IP address as 'host' parameter.
     // If it is a domain name, "AT+QIDNSIP=1" should be executed.
     // "AT+QIDNSIP=0" is for dotted decimal IP address.
-    IPAddress addr;
-    sendAT(GF("+QIDNSIP="),
-           (TinyGsmIpFromString(host) == IPAddress(0, 0, 0, 0) ? 0 : 1));
+    sendAT(GF("+QIDNSIP="), dnsIsAddress(addr.c_str()) ? 0 : 1);
     if (waitResponse() != 1) { return false; }
 
-    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
-    sendAT(GF("+QIOPEN="), mux, GF(",\""), GF("TCP"), GF("\",\""), host,
+    sendAT(GF("+QIOPEN="), mux, GF(",\""), GF("TCP"), GF("\",\""), addr,
            GF("\","), port);
     int8_t rsp = waitResponse(timeout_ms, GF("CONNECT OK" GSM_NL),
                               GF("CONNECT FAIL" GSM_NL),
                               GF("ALREADY CONNECT" GSM_NL));
+    // In case the host has moved
+    if (rsp != 1) { clearDnsCache(host); }
     return (1 == rsp);
   }
 
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+QISEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "SEND OK")) != 1) { return 0; }
 
@@ -488,7 +526,6 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -499,90 +536,13 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL, GsmConstStr r6 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    String r6s(r6); r6s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s, ",", r6s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5, r6};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 6);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (r6 && data.endsWith(r6)) {
-          index = 6;
-          goto finish;
-        } else if (data.endsWith(
-                       GF(GSM_NL "+QIRDI:"))) {  // TODO(?):  QIRD? or QIRDI?
-          // +QIRDI: <id>,<sc>,<sid>,<num>,<len>,< tlen>
-          streamSkipUntil(',');  // Skip the context
-          streamSkipUntil(',');  // Skip the role
-          // read the connection id
-          int8_t mux = streamGetIntBefore(',');
-          // read the number of packets in the buffer
-          int8_t num_packets = streamGetIntBefore(',');
-          // read the length of the current packet
-          streamSkipUntil(
-              ',');  // Skip the length of the current package in the buffer
-          int16_t len_total =
-              streamGetIntBefore('\n');  // Total length of all packages
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
-              num_packets >= 0 && len_total >= 0) {
-            sockets[mux]->sock_available = len_total;
-          }
-          data = "";
-          // DBG("### Got Data:", len_total, "on", mux);
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int8_t nl   = data.lastIndexOf(GSM_NL, data.length() - 8);
-          int8_t coma = data.indexOf(',', nl + 2);
-          int8_t mux  = data.substring(nl + 2, coma).toInt();
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("+QNITZ:"))) {
-          streamSkipUntil('\n');  // URC for time sync
-          DBG("### Network time updated.");
-          data = "";
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -595,8 +555,14 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL, GsmConstStr r6 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5, r6);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5, r6};
+    return waitResponseImpl(timeout_ms, NULL, responses, 6);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -611,6 +577,63 @@ class TinyGsmMC60 : public TinyGsmModem<TinyGsmMC60>,
     return waitResponse(1000, r1, r2, r3, r4, r5, r6);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmMC60>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmMC60> table[] = {
+        {GSM_URC_QIRDI, &TinyGsmMC60::handleQirdi},
+        {GSM_URC_CLOSED, &TinyGsmMC60::handleClosed},
+        {GSM_URC_QNITZ, &TinyGsmMC60::handleQnitz},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +QIRDI:
+  bool handleQirdi(const char*, String*) {
+    // TODO(?):  QIRD? or QIRDI?
+    // +QIRDI: <id>,<sc>,<sid>,<num>,<len>,< tlen>
+    streamSkipUntil(',');  // Skip the context
+    streamSkipUntil(',');  // Skip the role
+    // read the connection id
+    int8_t mux = streamGetIntBefore(',');
+    // read the number of packets in the buffer
+    int8_t num_packets = streamGetIntBefore(',');
+    // read the length of the current packet
+    // Skip the length of the current package in the buffer
+    streamSkipUntil(',');
+    // Total length of all packages
+    int16_t len_total = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
+        num_packets >= 0 && len_total >= 0) {
+      sockets[mux]->sock_available = len_total;
+    }
+    // DBG("### Got Data:", len_total, "on", mux);
+    return true;
+  }
+
+  // CLOSED
+  bool handleClosed(const char* line, String*) {
+    int8_t mux = atoi(line);
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
+  // +QNITZ:
+  bool handleQnitz(const char*, String*) {
+    streamSkipUntil('\n');  // URC for time sync
+    DBG("### Network time updated.");
+    return true;
+  }
+
  public:
   Stream& stream;
 
@@ -13,9 +13,21 @@
 // #define TINY_GSM_USE_HEX
 
 #define TINY_GSM_MUX_COUNT 10
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#if !defined(TINY_GSM_MAX_READ) && defined(TINY_GSM_USE_HEX)
+// Two HEX digits come for each byte, and +CIPRXGET=3 gives at most 1460
+#define TINY_GSM_MAX_READ 730
+#elif !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1460
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1500
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmGSMLocation.tpp"
 #include "TinyGsmModem.tpp"
@@ -32,6 +44,10 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_CIPRXGET[] TINY_GSM_PROGMEM = GSM_NL "+CIPRXGET:";
+static const char GSM_URC_RECEIVE[] TINY_GSM_PROGMEM  = GSM_NL "+RECEIVE:";
+static const char GSM_URC_IPCLOSE[] TINY_GSM_PROGMEM  = "+IPCLOSE:";
+static const char GSM_URC_CIPEVENT[] TINY_GSM_PROGMEM = "+CIPEVENT:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -44,8 +60,10 @@ enum RegStatus {
 };
 
 class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
+                       public TinyGsmAsync<TinyGsmSim5360>,
                        public TinyGsmGPRS<TinyGsmSim5360>,
                        public TinyGsmTCP<TinyGsmSim5360, TINY_GSM_MUX_COUNT>,
+                       public TinyGsmDNS<TinyGsmSim5360>,
                        public TinyGsmSMS<TinyGsmSim5360>,
                        public TinyGsmTime<TinyGsmSim5360>,
                        public TinyGsmNTP<TinyGsmSim5360>,
@@ -53,8 +71,10 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
                        public TinyGsmBattery<TinyGsmSim5360>,
                        public TinyGsmTemperature<TinyGsmSim5360> {
   friend class TinyGsmModem<TinyGsmSim5360>;
+  friend class TinyGsmAsync<TinyGsmSim5360>;
   friend class TinyGsmGPRS<TinyGsmSim5360>;
   friend class TinyGsmTCP<TinyGsmSim5360, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmSim5360>;
   friend class TinyGsmSMS<TinyGsmSim5360>;
   friend class TinyGsmTime<TinyGsmSim5360>;
   friend class TinyGsmNTP<TinyGsmSim5360>;
@@ -104,6 +124,7 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+CIPCLOSE="), mux);
       sock_connected = false;
@@ -500,6 +521,26 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
     return res;
   }
 
+  /*
+   * DNS functions
+   */
+ protected:
+  // As the template, except that the answer comes before the OK
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    sendAT(GF("+CDNSGIP=\""), host, '"');
+    // +CDNSGIP: 1,"<domain>","<IP>"[,"<IP2>"] or +CDNSGIP: 0,<error>
+    if (waitResponse(timeout_ms, GF(GSM_NL "+CDNSGIP:")) != 1) { return ""; }
+    String res;
+    if (streamGetIntBefore(',') == 1) {
+      streamSkipUntil(',');  // Skip the domain
+      streamSkipUntil('"');
+      res = stream.readStringUntil('"');
+    }
+    streamSkipUntil('\n');
+    waitResponse();
+    return res;
+  }
+
   /*
    * Client related functions
    */
@@ -511,9 +552,12 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
     sendAT(GF("+CIPRXGET=1"));
     if (waitResponse() != 1) { return false; }
 
-    // Establish a connection in multi-socket mode
     uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
-    sendAT(GF("+CIPOPEN="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","),
+    // A host looked up before goes by its address
+    String addr = dnsConnectHost(host, timeout_ms);
+
+    // Establish a connection in multi-socket mode
+    sendAT(GF("+CIPOPEN="), mux, ',', GF("\"TCP"), GF("\",\""), addr, GF("\","),
            port);
     // The reply is +CIPOPEN: ## of socket created
     if (waitResponse(timeout_ms, GF(GSM_NL "+CIPOPEN:")) != 1) { return false; }
@@ -523,7 +567,7 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "+CIPSEND:")) != 1) { return 0; }
     streamSkipUntil(',');  // Skip mux
@@ -547,9 +591,9 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
     //  ^^ Requested number of data bytes (1-1460 bytes)to be read
     int16_t len_confirmed = streamGetIntBefore('\n');
     // ^^ The data length which not read in the buffer
+#ifdef TINY_GSM_USE_HEX
     for (int i = 0; i < len_requested; i++) {
       uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
       while (stream.available() < 2 &&
              (millis() - startMillis < sockets[mux]->_timeout)) {
         TINY_GSM_YIELD();
@@ -560,15 +604,11 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
       buf[0] = stream.read();
       buf[1] = stream.read();
       char c = strtol(buf, NULL, 16);
+      moveCharToSocket(mux, c);
+    }
 #else
-      while (!stream.available() &&
-             (millis() - startMillis < sockets[mux]->_timeout)) {
-        TINY_GSM_YIELD();
-      }
-      char c = stream.read();
+    moveCharsFromStreamToFifo(mux, len_requested);
 #endif
-      sockets[mux]->rx.put(c);
-    }
     // DBG("### READ:", len_requested, "from", mux);
     // sockets[mux]->sock_available = modemGetAvailable(mux);
     sockets[mux]->sock_available = len_confirmed;
@@ -578,6 +618,14 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
 
   size_t modemGetAvailable(uint8_t mux) {
     if (!sockets[mux]) return 0;
+    size_t result = modemGetBuffered(mux);
+    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
+    return result;
+  }
+
+  // How much data the modem holds for the socket, without checking that it is
+  // still connected
+  size_t modemGetBuffered(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
     if (waitResponse(GF("+CIPRXGET:")) == 1) {
@@ -587,10 +635,23 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
       waitResponse();
     }
     // DBG("### Available:", result, "on", mux);
-    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
     return result;
   }
 
+  // The data is asked for socket by socket, but as modemGetConnected() reads
+  // the state of all sockets at once it only needs to be called one time
+  void modemRefreshSockets() {
+    int8_t emptyMux = -1;
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      GsmClientSim5360* sock = sockets[mux];
+      if (!sock || !sock->got_data) { continue; }
+      sock->got_data       = false;
+      sock->sock_available = modemGetBuffered(mux);
+      if (!sock->sock_available) { emptyMux = mux; }
+    }
+    if (emptyMux >= 0) { modemGetConnected(emptyMux); }
+  }
+
   bool modemGetConnected(uint8_t mux) {
     // Read the status of all sockets at once
     sendAT(GF("+CIPCLOSE?"));
@@ -609,7 +670,6 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -620,88 +680,13 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          int8_t mode = streamGetIntBefore(',');
-          if (mode == 1) {
-            int8_t mux = streamGetIntBefore('\n');
-            if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
-            }
-            data = "";
-            // DBG("### Got Data:", mux);
-          } else {
-            data += mode;
-          }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-            if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
-          }
-          data = "";
-          // DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("+IPCLOSE:"))) {
-          int8_t mux = streamGetIntBefore(',');
-          streamSkipUntil('\n');  // Skip the reason code
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("+CIPEVENT:"))) {
-          // Need to close all open sockets and release the network library.
-          // User will then need to reconnect.
-          DBG("### Network error!");
-          if (!isGprsConnected()) { gprsDisconnect(); }
-          data = "";
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -714,8 +699,14 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -730,6 +721,71 @@ class TinyGsmSim5360 : public TinyGsmModem<TinyGsmSim5360>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmSim5360>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmSim5360> table[] = {
+        {GSM_URC_CIPRXGET, &TinyGsmSim5360::handleCipRxGet},
+        {GSM_URC_RECEIVE, &TinyGsmSim5360::handleReceive},
+        {GSM_URC_IPCLOSE, &TinyGsmSim5360::handleIpClose},
+        {GSM_URC_CIPEVENT, &TinyGsmSim5360::handleCipEvent},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +CIPRXGET:
+  bool handleCipRxGet(const char*, String* data) {
+    int8_t mode = streamGetIntBefore(',');
+    if (mode != 1) {
+      if (data) { *data += mode; }
+      return false;
+    }
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+    }
+    // DBG("### Got Data:", mux);
+    return true;
+  }
+
+  // +RECEIVE:
+  bool handleReceive(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+      if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
+    }
+    // DBG("### Got Data:", len, "on", mux);
+    return true;
+  }
+
+  // +IPCLOSE:
+  bool handleIpClose(const char*, String*) {
+    int8_t mux = streamGetIntBefore(',');
+    streamSkipUntil('\n');  // Skip the reason code
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
+  // +CIPEVENT:
+  bool handleCipEvent(const char*, String*) {
+    // Need to close all open sockets and release the network library.
+    // User will then need to reconnect.
+    DBG("### Network error!");
+    if (!isGprsConnected()) { gprsDisconnect(); }
+    return true;
+  }
+
  public:
   Stream& stream;
 
@@ -13,11 +13,33 @@
 // #define TINY_GSM_USE_HEX
 
 #define TINY_GSM_MUX_COUNT 8
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#define TINY_GSM_MODEM_HAS_CONNECT_ASYNC
+#if !defined(TINY_GSM_MAX_READ) && defined(TINY_GSM_USE_HEX)
+// Two HEX digits come for each byte, and +CIPRXGET=3 gives at most 1460
+#define TINY_GSM_MAX_READ 730
+#elif !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1460
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1460
+#endif
 
 #include "TinyGsmClientSIM70xx.h"
 #include "TinyGsmTCP.tpp"
 
+static const char GSM_URC_CIPRXGET[] TINY_GSM_PROGMEM  = GSM_NL "+CIPRXGET:";
+static const char GSM_URC_RECEIVE[] TINY_GSM_PROGMEM   = GSM_NL "+RECEIVE:";
+static const char GSM_URC_CLOSED[] TINY_GSM_PROGMEM    = "CLOSED" GSM_NL;
+static const char GSM_URC_CONN_OK[] TINY_GSM_PROGMEM   = "CONNECT OK" GSM_NL;
+static const char GSM_URC_CONN_FAIL[] TINY_GSM_PROGMEM = "CONNECT FAIL" GSM_NL;
+static const char GSM_URC_PSNWID[] TINY_GSM_PROGMEM    = "*PSNWID:";
+static const char GSM_URC_PSUTTZ[] TINY_GSM_PROGMEM    = "*PSUTTZ:";
+static const char GSM_URC_CTZV[] TINY_GSM_PROGMEM      = "+CTZV:";
+static const char GSM_URC_DST[] TINY_GSM_PROGMEM       = "DST: ";
+static const char GSM_URC_SMS_READY[] TINY_GSM_PROGMEM =
+    GSM_NL "SMS Ready" GSM_NL;
 
 class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
                        public TinyGsmTCP<TinyGsmSim7000, TINY_GSM_MUX_COUNT> {
@@ -65,7 +87,21 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
     }
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
+    // Starts opening the connection and returns without waiting for it, so
+    // several clients can connect at the same time.  connecting() stays true
+    // until the modem reports back.
+    // Returns false if the modem refused to start.
+    bool connectAsync(const char* host, uint16_t port, int timeout_s = 75) {
+      stop();
+      TINY_GSM_YIELD();
+      rx.clear();
+      startConnect(timeout_s);
+      return connectStarted(
+          at->modemConnect(host, port, mux, false, timeout_s, true));
+    }
+
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+CIPCLOSE="), mux);
       sock_connected = false;
@@ -284,26 +320,35 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
    * Client related functions
    */
  protected:
+  // With async set, returns once the modem has taken the command and leaves
+  // the "<mux>, CONNECT OK" to the URC handler
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
-                    bool ssl = false, int timeout_s = 75) {
+                    bool ssl = false, int timeout_s = 75,
+                    bool async = false) {
     if (ssl) { DBG("SSL only supported using application on SIM7000!"); }
     uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
 
+    // A host looked up before goes by its address
+    String addr = dnsConnectHost(host, timeout_ms, async);
+
     // when not using SSL, the TCP application toolkit is more stable
-    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host,
+    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), addr,
            GF("\","), port);
-    return (1 ==
-            waitResponse(timeout_ms, GF("CONNECT OK" GSM_NL),
-                         GF("CONNECT FAIL" GSM_NL),
-                         GF("ALREADY CONNECT" GSM_NL), GF("ERROR" GSM_NL),
-                         GF("CLOSE OK" GSM_NL)));
+    if (async) { return dnsConnectStarted(host, mux, waitResponse() == 1); }
+    int8_t rsp = waitResponse(timeout_ms, GF("CONNECT OK" GSM_NL),
+                              GF("CONNECT FAIL" GSM_NL),
+                              GF("ALREADY CONNECT" GSM_NL), GF("ERROR" GSM_NL),
+                              GF("CLOSE OK" GSM_NL));
+    // In case the host has moved
+    if (rsp != 1) { clearDnsCache(host); }
+    return (1 == rsp);
   }
 
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
 
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
 
     if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) { return 0; }
@@ -331,9 +376,9 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
     // SRGD NOTE:  Contrary to above (which is copied from AT command manual)
     // this is actually be the number of bytes that will be remaining in the
     // buffer after the read.
+#ifdef TINY_GSM_USE_HEX
     for (int i = 0; i < len_requested; i++) {
       uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
       while (stream.available() < 2 &&
              (millis() - startMillis < sockets[mux]->_timeout)) {
         TINY_GSM_YIELD();
@@ -344,15 +389,11 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
       buf[0] = stream.read();
       buf[1] = stream.read();
       char c = strtol(buf, NULL, 16);
+      moveCharToSocket(mux, c);
+    }
 #else
-      while (!stream.available() &&
-             (millis() - startMillis < sockets[mux]->_timeout)) {
-        TINY_GSM_YIELD();
-      }
-      char c = stream.read();
+    moveCharsFromStreamToFifo(mux, len_requested);
 #endif
-      sockets[mux]->rx.put(c);
-    }
     // DBG("### READ:", len_requested, "from", mux);
     // sockets[mux]->sock_available = modemGetAvailable(mux);
     sockets[mux]->sock_available = len_confirmed;
@@ -363,6 +404,14 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
   size_t modemGetAvailable(uint8_t mux) {
     if (!sockets[mux]) return 0;
 
+    size_t result = modemGetBuffered(mux);
+    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
+    return result;
+  }
+
+  // How much data the modem holds for the socket, without checking that it is
+  // still connected
+  size_t modemGetBuffered(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
     if (waitResponse(GF("+CIPRXGET:")) == 1) {
@@ -372,10 +421,32 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
       waitResponse();
     }
     // DBG("### Available:", result, "on", mux);
-    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
     return result;
   }
 
+  // There is no command for the data held on all sockets, but one +CIPSTATUS
+  // gives the state of them all, so the sockets found empty are checked
+  // together
+  void modemRefreshSockets() {
+    int8_t  emptyMux = -1;
+    uint8_t empty    = 0;
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      GsmClientSim7000* sock = sockets[mux];
+      if (!sock || !sock->got_data) { continue; }
+      sock->got_data       = false;
+      sock->sock_available = modemGetBuffered(mux);
+      if (!sock->sock_available) {
+        emptyMux = mux;
+        empty++;
+      }
+    }
+    if (empty == 1) {
+      sockets[emptyMux]->sock_connected = modemGetConnected(emptyMux);
+    } else if (empty > 1) {
+      modemGetConnectedAll();
+    }
+  }
+
   bool modemGetConnected(uint8_t mux) {
     sendAT(GF("+CIPSTATUS="), mux);
     waitResponse(GF("+CIPSTATUS"));
@@ -386,11 +457,27 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
     return 1 == res;
   }
 
+  // Updates sock_connected of every socket from one +CIPSTATUS, which lists
+  // all of the modem's connections after the OK:
+  // C: 0,0,"TCP","151.139.237.11","80","CONNECTED"
+  void modemGetConnectedAll() {
+    sendAT(GF("+CIPSTATUS"));
+    if (waitResponse() != 1) { return; }
+    for (int i = 0; i < TINY_GSM_MUX_COUNT; i++) {
+      if (waitResponse(GF("C: ")) != 1) { break; }
+      int8_t mux = streamGetIntBefore(',');
+      // Any other state is caught by the end of the line
+      int8_t res = waitResponse(GF(",\"CONNECTED\"" GSM_NL), GF(GSM_NL));
+      if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+        sockets[mux]->sock_connected = (res == 1);
+      }
+    }
+  }
+
   /*
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -401,104 +488,13 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          int8_t mode = streamGetIntBefore(',');
-          if (mode == 1) {
-            int8_t mux = streamGetIntBefore('\n');
-            if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
-            }
-            data = "";
-            // DBG("### Got Data:", mux);
-          } else {
-            data += mode;
-          }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-            if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
-          }
-          data = "";
-          // DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int8_t nl   = data.lastIndexOf(GSM_NL, data.length() - 8);
-          int8_t coma = data.indexOf(',', nl + 2);
-          int8_t mux  = data.substring(nl + 2, coma).toInt();
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("*PSNWID:"))) {
-          streamSkipUntil('\n');  // Refresh network name by network
-          data = "";
-          DBG("### Network name updated.");
-        } else if (data.endsWith(GF("*PSUTTZ:"))) {
-          streamSkipUntil('\n');  // Refresh time and time zone by network
-          data = "";
-          DBG("### Network time and time zone updated.");
-        } else if (data.endsWith(GF("+CTZV:"))) {
-          streamSkipUntil('\n');  // Refresh network time zone by network
-          data = "";
-          DBG("### Network time zone updated.");
-        } else if (data.endsWith(GF("DST: "))) {
-          streamSkipUntil(
-              '\n');  // Refresh Network Daylight Saving Time by network
-          data = "";
-          DBG("### Daylight savings time state updated.");
-        } else if (data.endsWith(GF(GSM_NL "SMS Ready" GSM_NL))) {
-          data = "";
-          DBG("### Unexpected module reset!");
-          init();
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -511,8 +507,14 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -527,6 +529,117 @@ class TinyGsmSim7000 : public TinyGsmSim70xx<TinyGsmSim7000>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmSim7000>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmSim7000> table[] = {
+        {GSM_URC_CIPRXGET, &TinyGsmSim7000::handleCipRxGet},
+        {GSM_URC_RECEIVE, &TinyGsmSim7000::handleReceive},
+        {GSM_URC_CLOSED, &TinyGsmSim7000::handleClosed},
+        {GSM_URC_CONN_OK, &TinyGsmSim7000::handleConnectOk},
+        {GSM_URC_CONN_FAIL, &TinyGsmSim7000::handleConnectFail},
+        {GSM_URC_PSNWID, &TinyGsmSim7000::handlePsnwid},
+        {GSM_URC_PSUTTZ, &TinyGsmSim7000::handlePsuttz},
+        {GSM_URC_CTZV, &TinyGsmSim7000::handleCtzv},
+        {GSM_URC_DST, &TinyGsmSim7000::handleDst},
+        {GSM_URC_SMS_READY, &TinyGsmSim7000::handleSmsReady},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +CIPRXGET:
+  bool handleCipRxGet(const char*, String* data) {
+    int8_t mode = streamGetIntBefore(',');
+    if (mode != 1) {
+      if (data) { *data += mode; }
+      return false;
+    }
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+    }
+    // DBG("### Got Data:", mux);
+    return true;
+  }
+
+  // +RECEIVE:
+  bool handleReceive(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+      if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
+    }
+    // DBG("### Got Data:", len, "on", mux);
+    return true;
+  }
+
+  // CLOSED
+  bool handleClosed(const char* line, String*) {
+    int8_t mux = atoi(line);
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
+  // CONNECT OK, after a connectAsync()
+  bool handleConnectOk(const char* line, String*) {
+    connectFinished(atoi(line), true);
+    dnsConnectFinished(atoi(line), true);
+    return true;
+  }
+
+  // CONNECT FAIL
+  bool handleConnectFail(const char* line, String*) {
+    connectFinished(atoi(line), false);
+    dnsConnectFinished(atoi(line), false);
+    return true;
+  }
+
+  // *PSNWID:
+  bool handlePsnwid(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh network name by network
+    DBG("### Network name updated.");
+    return true;
+  }
+
+  // *PSUTTZ:
+  bool handlePsuttz(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh time and time zone by network
+    DBG("### Network time and time zone updated.");
+    return true;
+  }
+
+  // +CTZV:
+  bool handleCtzv(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh network time zone by network
+    DBG("### Network time zone updated.");
+    return true;
+  }
+
+  // DST:
+  bool handleDst(const char*, String*) {
+    // Refresh Network Daylight Saving Time by network
+    streamSkipUntil('\n');
+    DBG("### Daylight savings time state updated.");
+    return true;
+  }
+
+  // SMS Ready
+  bool handleSmsReady(const char*, String*) {
+    DBG("### Unexpected module reset!");
+    init();
+    return true;
+  }
+
  protected:
   GsmClientSim7000* sockets[TINY_GSM_MUX_COUNT];
 };
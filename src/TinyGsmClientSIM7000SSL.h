@@ -13,12 +13,28 @@
 // #define TINY_GSM_USE_HEX
 
 #define TINY_GSM_MUX_COUNT 2
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1460
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1459
+#endif
 
 #include "TinyGsmClientSIM70xx.h"
 #include "TinyGsmTCP.tpp"
 #include "TinyGsmSSL.tpp"
 
+static const char GSM_URC_CARECV[] TINY_GSM_PROGMEM    = "+CARECV:";
+static const char GSM_URC_CADATAIND[] TINY_GSM_PROGMEM = "+CADATAIND:";
+static const char GSM_URC_CASTATE[] TINY_GSM_PROGMEM   = "+CASTATE:";
+static const char GSM_URC_PSNWID[] TINY_GSM_PROGMEM    = "*PSNWID:";
+static const char GSM_URC_PSUTTZ[] TINY_GSM_PROGMEM    = "*PSUTTZ:";
+static const char GSM_URC_CTZV[] TINY_GSM_PROGMEM      = "+CTZV:";
+static const char GSM_URC_DST[] TINY_GSM_PROGMEM       = "DST: ";
+static const char GSM_URC_SMS_READY[] TINY_GSM_PROGMEM =
+    GSM_NL "SMS Ready" GSM_NL;
 class TinyGsmSim7000SSL
     : public TinyGsmSim70xx<TinyGsmSim7000SSL>,
       public TinyGsmTCP<TinyGsmSim7000SSL, TINY_GSM_MUX_COUNT>,
@@ -69,6 +85,7 @@ class TinyGsmSim7000SSL
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+CACLOSE="), mux);
       sock_connected = false;
@@ -387,12 +404,15 @@ class TinyGsmSim7000SSL
       waitResponse();
     }
 
+    // A host looked up before goes by its address; SSL needs the name itself
+    String addr = ssl ? String(host) : dnsConnectHost(host, timeout_ms);
+
     // actually open the connection
     // AT+CAOPEN=<cid>[,<conn_type>],<server>,<port>
     // <cid> TCP/UDP identifier
     // <conn_type> "TCP" or "UDP"
     // NOTE:  the "TCP" can't be included
-    sendAT(GF("+CAOPEN="), mux, GF(",\""), host, GF("\","), port);
+    sendAT(GF("+CAOPEN="), mux, GF(",\""), addr, GF("\","), port);
     if (waitResponse(timeout_ms, GF(GSM_NL "+CAOPEN:")) != 1) { return 0; }
     // returns OK/r/n/r/n+CAOPEN: <cid>,<result>
     // <result> 0: Success
@@ -417,6 +437,8 @@ class TinyGsmSim7000SSL
     int8_t res = streamGetIntBefore('\n');
     waitResponse();
 
+    // In case the host has moved
+    if (res != 0) { clearDnsCache(host); }
     return 0 == res;
   }
 
@@ -425,7 +447,7 @@ class TinyGsmSim7000SSL
     sendAT(GF("+CASEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
 
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
 
     // after posting data, module responds with:
@@ -466,15 +488,7 @@ class TinyGsmSim7000SSL
       return 0;
     }
 
-    for (int i = 0; i < len_confirmed; i++) {
-      uint32_t startMillis = millis();
-      while (!stream.available() &&
-             (millis() - startMillis < sockets[mux]->_timeout)) {
-        TINY_GSM_YIELD();
-      }
-      char c = stream.read();
-      sockets[mux]->rx.put(c);
-    }
+    moveCharsFromStreamToFifo(mux, len_confirmed);
     waitResponse();
     // DBG("### READ:", len_confirmed, "from", mux);
     // make sure the sock available number is accurate again
@@ -536,6 +550,19 @@ class TinyGsmSim7000SSL
     return sockets[mux]->sock_available;
   }
 
+  // A single modemGetAvailable() refreshes every socket, so it only needs to
+  // be called for the first one flagged
+  void modemRefreshSockets() {
+    int8_t first = -1;
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      GsmClientSim7000SSL* sock = sockets[mux];
+      if (!sock || !sock->got_data) { continue; }
+      sock->got_data = false;
+      if (first < 0) { first = mux; }
+    }
+    if (first >= 0) { modemGetAvailable(first); }
+  }
+
   bool modemGetConnected(uint8_t mux) {
     // NOTE:  This gets the state of all connections that have been opened
     // since the last connection
@@ -588,7 +615,6 @@ class TinyGsmSim7000SSL
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -599,101 +625,13 @@ class TinyGsmSim7000SSL
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+CARECV:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-            if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
-          }
-          data = "";
-          DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("+CADATAIND:"))) {
-          int8_t mux = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-          }
-          data = "";
-          DBG("### Got Data:", mux);
-        } else if (data.endsWith(GF("+CASTATE:"))) {
-          int8_t mux   = streamGetIntBefore(',');
-          int8_t state = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            if (state != 1) {
-              sockets[mux]->sock_connected = false;
-              DBG("### Closed: ", mux);
-            }
-          }
-          data = "";
-        } else if (data.endsWith(GF("*PSNWID:"))) {
-          streamSkipUntil('\n');  // Refresh network name by network
-          data = "";
-          DBG("### Network name updated.");
-        } else if (data.endsWith(GF("*PSUTTZ:"))) {
-          streamSkipUntil('\n');  // Refresh time and time zone by network
-          data = "";
-          DBG("### Network time and time zone updated.");
-        } else if (data.endsWith(GF("+CTZV:"))) {
-          streamSkipUntil('\n');  // Refresh network time zone by network
-          data = "";
-          DBG("### Network time zone updated.");
-        } else if (data.endsWith(GF("DST: "))) {
-          streamSkipUntil(
-              '\n');  // Refresh Network Daylight Saving Time by network
-          data = "";
-          DBG("### Daylight savings time state updated.");
-        } else if (data.endsWith(GF(GSM_NL "SMS Ready" GSM_NL))) {
-          data = "";
-          DBG("### Unexpected module reset!");
-          init();
-          data = "";
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -706,8 +644,14 @@ class TinyGsmSim7000SSL
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -722,6 +666,99 @@ class TinyGsmSim7000SSL
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmSim7000SSL>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmSim7000SSL> table[] = {
+        {GSM_URC_CARECV, &TinyGsmSim7000SSL::handleCaRecv},
+        {GSM_URC_CADATAIND, &TinyGsmSim7000SSL::handleCaDataInd},
+        {GSM_URC_CASTATE, &TinyGsmSim7000SSL::handleCaState},
+        {GSM_URC_PSNWID, &TinyGsmSim7000SSL::handlePsnwid},
+        {GSM_URC_PSUTTZ, &TinyGsmSim7000SSL::handlePsuttz},
+        {GSM_URC_CTZV, &TinyGsmSim7000SSL::handleCtzv},
+        {GSM_URC_DST, &TinyGsmSim7000SSL::handleDst},
+        {GSM_URC_SMS_READY, &TinyGsmSim7000SSL::handleSmsReady},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +CARECV:
+  bool handleCaRecv(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+      if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
+    }
+    DBG("### Got Data:", len, "on", mux);
+    return true;
+  }
+
+  // +CADATAIND:
+  bool handleCaDataInd(const char*, String*) {
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+    }
+    DBG("### Got Data:", mux);
+    return true;
+  }
+
+  // +CASTATE:
+  bool handleCaState(const char*, String*) {
+    int8_t mux   = streamGetIntBefore(',');
+    int8_t state = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      if (state != 1) {
+        sockets[mux]->sock_connected = false;
+        DBG("### Closed: ", mux);
+      }
+    }
+    return true;
+  }
+
+  // *PSNWID:
+  bool handlePsnwid(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh network name by network
+    DBG("### Network name updated.");
+    return true;
+  }
+
+  // *PSUTTZ:
+  bool handlePsuttz(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh time and time zone by network
+    DBG("### Network time and time zone updated.");
+    return true;
+  }
+
+  // +CTZV:
+  bool handleCtzv(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh network time zone by network
+    DBG("### Network time zone updated.");
+    return true;
+  }
+
+  // DST:
+  bool handleDst(const char*, String*) {
+    // Refresh Network Daylight Saving Time by network
+    streamSkipUntil('\n');
+    DBG("### Daylight savings time state updated.");
+    return true;
+  }
+
+  // SMS Ready
+  bool handleSmsReady(const char*, String*) {
+    DBG("### Unexpected module reset!");
+    init();
+    return true;
+  }
+
  protected:
   GsmClientSim7000SSL* sockets[TINY_GSM_MUX_COUNT];
   String               certificates[TINY_GSM_MUX_COUNT];
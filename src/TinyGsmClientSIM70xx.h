@@ -12,7 +12,9 @@
 // #define TINY_GSM_DEBUG Serial
 // #define TINY_GSM_USE_HEX
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmGPS.tpp"
 #include "TinyGsmModem.tpp"
@@ -41,19 +43,23 @@ enum RegStatus {
 
 template <class modemType>
 class TinyGsmSim70xx : public TinyGsmModem<TinyGsmSim70xx<modemType>>,
+                       public TinyGsmAsync<TinyGsmSim70xx<modemType>>,
                        public TinyGsmGPRS<TinyGsmSim70xx<modemType>>,
                        public TinyGsmSMS<TinyGsmSim70xx<modemType>>,
                        public TinyGsmGPS<TinyGsmSim70xx<modemType>>,
                        public TinyGsmTime<TinyGsmSim70xx<modemType>>,
                        public TinyGsmNTP<TinyGsmSim70xx<modemType>>,
+                       public TinyGsmDNS<TinyGsmSim70xx<modemType>>,
                        public TinyGsmBattery<TinyGsmSim70xx<modemType>>,
                        public TinyGsmGSMLocation<TinyGsmSim70xx<modemType>> {
   friend class TinyGsmModem<TinyGsmSim70xx<modemType>>;
+  friend class TinyGsmAsync<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmGPRS<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmSMS<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmGPS<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmTime<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmNTP<TinyGsmSim70xx<modemType>>;
+  friend class TinyGsmDNS<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmBattery<TinyGsmSim70xx<modemType>>;
   friend class TinyGsmGSMLocation<TinyGsmSim70xx<modemType>>;
 
@@ -565,6 +571,11 @@ class TinyGsmSim70xx : public TinyGsmModem<TinyGsmSim70xx<modemType>>,
    */
   // Can sync with server using CNTP as per template
 
+  /*
+   * DNS functions
+   */
+  // Can look up hosts with +CDNSGIP as per template
+
   /*
    * Battery functions
    */
@@ -603,8 +614,7 @@ class TinyGsmSim70xx : public TinyGsmModem<TinyGsmSim70xx<modemType>>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    String data;
-    return thisModem().waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+    return thisModem().waitResponse(timeout_ms, r1, r2, r3, r4, r5);
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -619,6 +629,15 @@ class TinyGsmSim70xx : public TinyGsmModem<TinyGsmSim70xx<modemType>>,
     return thisModem().waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // should implement in sub-classes
+  static const TinyGsmUrc<modemType>* urcTable() {
+    return modemType::urcTable();
+  }
+
  public:
   Stream& stream;
 
@@ -14,10 +14,24 @@
 // #define TINY_GSM_USE_HEX
 
 #define TINY_GSM_MUX_COUNT 5
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#define TINY_GSM_MODEM_HAS_CONNECT_ASYNC
+#define TINY_GSM_UDP_CONNECTED
+#if !defined(TINY_GSM_MAX_READ) && defined(TINY_GSM_USE_HEX)
+// Two HEX digits come for each byte, and +CIPRXGET=3 gives at most 1460
+#define TINY_GSM_MAX_READ 730
+#elif !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1460
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1460
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
 #include "TinyGsmCalling.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmGSMLocation.tpp"
 #include "TinyGsmModem.tpp"
@@ -25,6 +39,7 @@
 #include "TinyGsmSSL.tpp"
 #include "TinyGsmTCP.tpp"
 #include "TinyGsmTime.tpp"
+#include "TinyGsmUDP.tpp"
 #include "TinyGsmNTP.tpp"
 
 #define GSM_NL "\r\n"
@@ -34,6 +49,15 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_CIPRXGET[] TINY_GSM_PROGMEM  = GSM_NL "+CIPRXGET:";
+static const char GSM_URC_RECEIVE[] TINY_GSM_PROGMEM   = GSM_NL "+RECEIVE:";
+static const char GSM_URC_CLOSED[] TINY_GSM_PROGMEM    = "CLOSED" GSM_NL;
+static const char GSM_URC_CONN_OK[] TINY_GSM_PROGMEM   = "CONNECT OK" GSM_NL;
+static const char GSM_URC_CONN_FAIL[] TINY_GSM_PROGMEM = "CONNECT FAIL" GSM_NL;
+static const char GSM_URC_PSNWID[] TINY_GSM_PROGMEM    = "*PSNWID:";
+static const char GSM_URC_PSUTTZ[] TINY_GSM_PROGMEM    = "*PSUTTZ:";
+static const char GSM_URC_CTZV[] TINY_GSM_PROGMEM      = "+CTZV:";
+static const char GSM_URC_DST[] TINY_GSM_PROGMEM       = "DST:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -45,8 +69,11 @@ enum RegStatus {
   REG_UNKNOWN      = 4,
 };
 class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
+                      public TinyGsmAsync<TinyGsmSim800>,
                       public TinyGsmGPRS<TinyGsmSim800>,
                       public TinyGsmTCP<TinyGsmSim800, TINY_GSM_MUX_COUNT>,
+                      public TinyGsmDNS<TinyGsmSim800>,
+                      public TinyGsmUDP<TinyGsmSim800, TINY_GSM_MUX_COUNT>,
                       public TinyGsmSSL<TinyGsmSim800>,
                       public TinyGsmCalling<TinyGsmSim800>,
                       public TinyGsmSMS<TinyGsmSim800>,
@@ -55,8 +82,11 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
                       public TinyGsmNTP<TinyGsmSim800>,
                       public TinyGsmBattery<TinyGsmSim800> {
   friend class TinyGsmModem<TinyGsmSim800>;
+  friend class TinyGsmAsync<TinyGsmSim800>;
   friend class TinyGsmGPRS<TinyGsmSim800>;
   friend class TinyGsmTCP<TinyGsmSim800, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmSim800>;
+  friend class TinyGsmUDP<TinyGsmSim800, TINY_GSM_MUX_COUNT>;
   friend class TinyGsmSSL<TinyGsmSim800>;
   friend class TinyGsmCalling<TinyGsmSim800>;
   friend class TinyGsmSMS<TinyGsmSim800>;
@@ -106,7 +136,21 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
     }
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
+    // Starts opening the connection and returns without waiting for it, so
+    // several clients can connect at the same time.  connecting() stays true
+    // until the modem reports back.
+    // Returns false if the modem refused to start.
+    bool connectAsync(const char* host, uint16_t port, int timeout_s = 75) {
+      stop();
+      TINY_GSM_YIELD();
+      rx.clear();
+      startConnect(timeout_s);
+      return connectStarted(
+          at->modemConnect(host, port, mux, false, timeout_s, true));
+    }
+
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+CIPCLOSE="), mux, GF(",1"));  // Quick close
       sock_connected = false;
@@ -145,6 +189,12 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
   };
 
+  /*
+   * Inner UDP Socket
+   */
+ public:
+  typedef GsmUDP<GsmClientSim800> GsmUDPSim800;
+
   /*
    * Constructor
    */
@@ -506,14 +556,24 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
    */
   // Can sync with server using CNTP as per template
 
+  /*
+   * DNS functions
+   */
+  // Can look up hosts with +CDNSGIP as per template
+
   /*
    * Client related functions
    */
  protected:
+  // With async set, returns once the modem has taken the command and leaves
+  // the "<mux>, CONNECT OK" to the URC handler
   bool modemConnect(const char* host, uint16_t port, uint8_t mux,
-                    bool ssl = false, int timeout_s = 75) {
+                    bool ssl = false, int timeout_s = 75,
+                    bool async = false) {
     int8_t   rsp;
     uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    // A host looked up before goes by its address; SSL needs the name itself
+    String addr = ssl ? String(host) : dnsConnectHost(host, timeout_ms, async);
 #if !defined(TINY_GSM_MODEM_SIM900)
     sendAT(GF("+CIPSSL="), ssl);
     rsp = waitResponse();
@@ -531,19 +591,53 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
     if (waitResponse() != 1) return false;
 #endif
 #endif
-    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host,
+    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), addr,
            GF("\","), port);
+    if (async) { return dnsConnectStarted(host, mux, waitResponse() == 1); }
     rsp = waitResponse(
         timeout_ms, GF("CONNECT OK" GSM_NL), GF("CONNECT FAIL" GSM_NL),
         GF("ALREADY CONNECT" GSM_NL), GF("ERROR" GSM_NL),
         GF("CLOSE OK" GSM_NL));  // Happens when HTTPS handshake fails
+    // In case the host has moved
+    if (rsp != 1) { clearDnsCache(host); }
     return (1 == rsp);
   }
 
+  // UDP sockets are opened to the one address they send to
+  bool modemOpenUdp(const char* host, uint16_t port, uint16_t localPort,
+                    uint8_t* mux) {
+#if !defined(TINY_GSM_MODEM_SIM900)
+    sendAT(GF("+CIPSSL=0"));
+    waitResponse();
+#endif
+    if (localPort) {
+      sendAT(GF("+CLPORT="), *mux, GF(",\"UDP\","), localPort);
+      waitResponse();
+    }
+    sendAT(GF("+CIPSTART="), *mux, ',', GF("\"UDP"), GF("\",\""), host,
+           GF("\","), port);
+    return waitResponse(75000L, GF("CONNECT OK" GSM_NL),
+                        GF("CONNECT FAIL" GSM_NL),
+                        GF("ALREADY CONNECT" GSM_NL),
+                        GF("ERROR" GSM_NL)) == 1;
+  }
+
+  int16_t modemSendTo(const char*, uint16_t, const void* buff, size_t len,
+                      uint8_t mux) {
+    return modemSend(buff, len, mux);
+  }
+
+  // Replies can only come from the address the socket was opened to, so the
+  // sender is already known.  +CIPRXGET does not keep the datagrams apart, so
+  // a read takes in all that has come (up to size) as one.
+  size_t modemReadFrom(size_t size, uint8_t mux, IPAddress*, uint16_t*) {
+    return modemRead(size, mux);
+  }
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+CIPSEND="), mux, ',', (uint16_t)len);
     if (waitResponse(GF(">")) != 1) { return 0; }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) { return 0; }
     streamSkipUntil(',');  // Skip mux
@@ -569,9 +663,9 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
     // SRGD NOTE:  Contrary to above (which is copied from AT command manual)
     // this is actually be the number of bytes that will be remaining in the
     // buffer after the read.
+#ifdef TINY_GSM_USE_HEX
     for (int i = 0; i < len_requested; i++) {
       uint32_t startMillis = millis();
-#ifdef TINY_GSM_USE_HEX
       while (stream.available() < 2 &&
              (millis() - startMillis < sockets[mux]->_timeout)) {
         TINY_GSM_YIELD();
@@ -582,15 +676,11 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
       buf[0] = stream.read();
       buf[1] = stream.read();
       char c = strtol(buf, NULL, 16);
+      moveCharToSocket(mux, c);
+    }
 #else
-      while (!stream.available() &&
-             (millis() - startMillis < sockets[mux]->_timeout)) {
-        TINY_GSM_YIELD();
-      }
-      char c = stream.read();
+    moveCharsFromStreamToFifo(mux, len_requested);
 #endif
-      sockets[mux]->rx.put(c);
-    }
     // DBG("### READ:", len_requested, "from", mux);
     // sockets[mux]->sock_available = modemGetAvailable(mux);
     sockets[mux]->sock_available = len_confirmed;
@@ -600,6 +690,14 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
 
   size_t modemGetAvailable(uint8_t mux) {
     if (!sockets[mux]) return 0;
+    size_t result = modemGetBuffered(mux);
+    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
+    return result;
+  }
+
+  // How much data the modem holds for the socket, without checking that it is
+  // still connected
+  size_t modemGetBuffered(uint8_t mux) {
     sendAT(GF("+CIPRXGET=4,"), mux);
     size_t result = 0;
     if (waitResponse(GF("+CIPRXGET:")) == 1) {
@@ -609,10 +707,32 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
       waitResponse();
     }
     // DBG("### Available:", result, "on", mux);
-    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
     return result;
   }
 
+  // There is no command for the data held on all sockets, but one +CIPSTATUS
+  // gives the state of them all, so the sockets found empty are checked
+  // together
+  void modemRefreshSockets() {
+    int8_t  emptyMux = -1;
+    uint8_t empty    = 0;
+    for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      GsmClientSim800* sock = sockets[mux];
+      if (!sock || !sock->got_data) { continue; }
+      sock->got_data       = false;
+      sock->sock_available = modemGetBuffered(mux);
+      if (!sock->sock_available) {
+        emptyMux = mux;
+        empty++;
+      }
+    }
+    if (empty == 1) {
+      sockets[emptyMux]->sock_connected = modemGetConnected(emptyMux);
+    } else if (empty > 1) {
+      modemGetConnectedAll();
+    }
+  }
+
   bool modemGetConnected(uint8_t mux) {
     sendAT(GF("+CIPSTATUS="), mux);
     waitResponse(GF("+CIPSTATUS"));
@@ -623,11 +743,27 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
     return 1 == res;
   }
 
+  // Updates sock_connected of every socket from one +CIPSTATUS, which lists
+  // all six of the modem's connections after the OK:
+  // C: 0,0,"TCP","151.139.237.11","80","CONNECTED"
+  void modemGetConnectedAll() {
+    sendAT(GF("+CIPSTATUS"));
+    if (waitResponse() != 1) { return; }
+    for (int i = 0; i < 6; i++) {
+      if (waitResponse(GF("C: ")) != 1) { break; }
+      int8_t mux = streamGetIntBefore(',');
+      // Any other state is caught by the end of the line
+      int8_t res = waitResponse(GF(",\"CONNECTED\"" GSM_NL), GF(GSM_NL));
+      if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+        sockets[mux]->sock_connected = (res == 1);
+      }
+    }
+  }
+
   /*
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -638,100 +774,13 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
-          int8_t mode = streamGetIntBefore(',');
-          if (mode == 1) {
-            int8_t mux = streamGetIntBefore('\n');
-            if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-              sockets[mux]->got_data = true;
-            }
-            data = "";
-            // DBG("### Got Data:", mux);
-          } else {
-            data += mode;
-          }
-        } else if (data.endsWith(GF(GSM_NL "+RECEIVE:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-            if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
-          }
-          data = "";
-          // DBG("### Got Data:", len, "on", mux);
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int8_t nl   = data.lastIndexOf(GSM_NL, data.length() - 8);
-          int8_t coma = data.indexOf(',', nl + 2);
-          int8_t mux  = data.substring(nl + 2, coma).toInt();
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### Closed: ", mux);
-        } else if (data.endsWith(GF("*PSNWID:"))) {
-          streamSkipUntil('\n');  // Refresh network name by network
-          data = "";
-          DBG("### Network name updated.");
-        } else if (data.endsWith(GF("*PSUTTZ:"))) {
-          streamSkipUntil('\n');  // Refresh time and time zone by network
-          data = "";
-          DBG("### Network time and time zone updated.");
-        } else if (data.endsWith(GF("+CTZV:"))) {
-          streamSkipUntil('\n');  // Refresh network time zone by network
-          data = "";
-          DBG("### Network time zone updated.");
-        } else if (data.endsWith(GF("DST:"))) {
-          streamSkipUntil(
-              '\n');  // Refresh Network Daylight Saving Time by network
-          data = "";
-          DBG("### Daylight savings time state updated.");
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -744,8 +793,14 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -760,6 +815,109 @@ class TinyGsmSim800 : public TinyGsmModem<TinyGsmSim800>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmSim800>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmSim800> table[] = {
+        {GSM_URC_CIPRXGET, &TinyGsmSim800::handleCipRxGet},
+        {GSM_URC_RECEIVE, &TinyGsmSim800::handleReceive},
+        {GSM_URC_CLOSED, &TinyGsmSim800::handleClosed},
+        {GSM_URC_CONN_OK, &TinyGsmSim800::handleConnectOk},
+        {GSM_URC_CONN_FAIL, &TinyGsmSim800::handleConnectFail},
+        {GSM_URC_PSNWID, &TinyGsmSim800::handlePsnwid},
+        {GSM_URC_PSUTTZ, &TinyGsmSim800::handlePsuttz},
+        {GSM_URC_CTZV, &TinyGsmSim800::handleCtzv},
+        {GSM_URC_DST, &TinyGsmSim800::handleDst},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +CIPRXGET:
+  bool handleCipRxGet(const char*, String* data) {
+    int8_t mode = streamGetIntBefore(',');
+    if (mode != 1) {
+      if (data) { *data += mode; }
+      return false;
+    }
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+    }
+    // DBG("### Got Data:", mux);
+    return true;
+  }
+
+  // +RECEIVE:
+  bool handleReceive(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+      if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
+    }
+    // DBG("### Got Data:", len, "on", mux);
+    return true;
+  }
+
+  // CLOSED
+  bool handleClosed(const char* line, String*) {
+    int8_t mux = atoi(line);
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### Closed: ", mux);
+    return true;
+  }
+
+  // CONNECT OK, after a connectAsync()
+  bool handleConnectOk(const char* line, String*) {
+    connectFinished(atoi(line), true);
+    dnsConnectFinished(atoi(line), true);
+    return true;
+  }
+
+  // CONNECT FAIL
+  bool handleConnectFail(const char* line, String*) {
+    connectFinished(atoi(line), false);
+    dnsConnectFinished(atoi(line), false);
+    return true;
+  }
+
+  // *PSNWID:
+  bool handlePsnwid(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh network name by network
+    DBG("### Network name updated.");
+    return true;
+  }
+
+  // *PSUTTZ:
+  bool handlePsuttz(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh time and time zone by network
+    DBG("### Network time and time zone updated.");
+    return true;
+  }
+
+  // +CTZV:
+  bool handleCtzv(const char*, String*) {
+    streamSkipUntil('\n');  // Refresh network time zone by network
+    DBG("### Network time zone updated.");
+    return true;
+  }
+
+  // DST:
+  bool handleDst(const char*, String*) {
+    // Refresh Network Daylight Saving Time by network
+    streamSkipUntil('\n');
+    DBG("### Daylight savings time state updated.");
+    return true;
+  }
+
  public:
   Stream& stream;
 
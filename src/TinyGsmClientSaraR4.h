@@ -13,9 +13,24 @@
 // #define TINY_GSM_DEBUG Serial
 
 #define TINY_GSM_MUX_COUNT 7
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#define TINY_GSM_MODEM_HAS_CONNECT_ASYNC
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1024
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1024
+#endif
+#if !defined(TINY_GSM_POLL_MAX)
+// +UUSORD is sent with the unread count each time data arrives, so polling
+// is only a safety net
+#define TINY_GSM_POLL_MAX 30000
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmGPS.tpp"
 #include "TinyGsmGSMLocation.tpp"
@@ -33,6 +48,9 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_UUSORD[] TINY_GSM_PROGMEM = "+UUSORD:";
+static const char GSM_URC_UUSOCL[] TINY_GSM_PROGMEM = "+UUSOCL:";
+static const char GSM_URC_UUSOCO[] TINY_GSM_PROGMEM = "+UUSOCO:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -45,8 +63,10 @@ enum RegStatus {
 };
 
 class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
+                      public TinyGsmAsync<TinyGsmSaraR4>,
                       public TinyGsmGPRS<TinyGsmSaraR4>,
                       public TinyGsmTCP<TinyGsmSaraR4, TINY_GSM_MUX_COUNT>,
+                      public TinyGsmDNS<TinyGsmSaraR4>,
                       public TinyGsmSSL<TinyGsmSaraR4>,
                       public TinyGsmBattery<TinyGsmSaraR4>,
                       public TinyGsmGSMLocation<TinyGsmSaraR4>,
@@ -55,8 +75,10 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
                       public TinyGsmTemperature<TinyGsmSaraR4>,
                       public TinyGsmTime<TinyGsmSaraR4> {
   friend class TinyGsmModem<TinyGsmSaraR4>;
+  friend class TinyGsmAsync<TinyGsmSaraR4>;
   friend class TinyGsmGPRS<TinyGsmSaraR4>;
   friend class TinyGsmTCP<TinyGsmSaraR4, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmSaraR4>;
   friend class TinyGsmSSL<TinyGsmSaraR4>;
   friend class TinyGsmBattery<TinyGsmSaraR4>;
   friend class TinyGsmGSMLocation<TinyGsmSaraR4>;
@@ -123,7 +145,31 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
       return connect(ip, port, 120);
     }
 
+    // Starts opening the connection and returns without waiting for it, so
+    // several clients can connect at the same time.  connecting() stays true
+    // until the modem reports back.
+    // Returns false if the modem refused to start.
+    bool connectAsync(const char* host, uint16_t port, int timeout_s = 120) {
+      // Older modules can only connect synchronously
+      if (!at->supportsAsyncSockets) { return connect(host, port, timeout_s); }
+      TINY_GSM_YIELD();
+      rx.clear();
+      startConnect(timeout_s);
+
+      uint8_t oldMux   = mux;
+      bool    accepted = at->modemConnect(host, port, &mux, false, timeout_s,
+                                          true);
+      if (mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", mux);
+        at->sockets[oldMux] = NULL;
+      }
+      at->sockets[mux] = this;
+
+      return connectStarted(accepted);
+    }
+
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       uint32_t startMillis = millis();
       dumpModemBuffer(maxWaitMs);
       // We want to use an async socket close because the syncrhonous close of
@@ -633,13 +679,34 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
     return temp;
   }
 
+  /*
+   * DNS functions
+   */
+ protected:
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    // AT+UDNSRN=<resolution_type>,<domain_ip_string>
+    // <resolution_type> - 0 for a name to an address
+    sendAT(GF("+UDNSRN=0,\""), host, '"');
+    if (waitResponse(timeout_ms, GF(GSM_NL "+UDNSRN:")) != 1) { return ""; }
+    streamSkipUntil('"');
+    String res = stream.readStringUntil('"');
+    waitResponse();
+    return res;
+  }
+
   /*
    * Client related functions
    */
  protected:
+  // With async set, returns as soon as the modem has taken the command,
+  // leaving the +UUSOCO to the URC handler
   bool modemConnect(const char* host, uint16_t port, uint8_t* mux,
-                    bool ssl = false, int timeout_s = 120) {
-    uint32_t timeout_ms  = ((uint32_t)timeout_s) * 1000;
+                    bool ssl = false, int timeout_s = 120,
+                    bool async = false) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    // A host looked up before goes by its address; SSL needs the name itself
+    String addr = ssl ? String(host) : dnsConnectHost(host, timeout_ms, async);
+
     uint32_t startMillis = millis();
 
     // create a socket
@@ -677,12 +744,16 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
     if (supportsAsyncSockets) {
       DBG("### Opening socket asynchronously!  Socket cannot be used until "
           "the URC '+UUSOCO' appears.");
-      sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port, ",1");
+      sendAT(GF("+USOCO="), *mux, ",\"", addr, "\",", port, ",1");
+      if (async) {
+        return dnsConnectStarted(host, *mux, waitResponse() == 1);
+      }
       if (waitResponse(timeout_ms - (millis() - startMillis),
                        GF(GSM_NL "+UUSOCO:")) == 1) {
         streamGetIntBefore(',');  // skip repeated mux
         int8_t connection_status = streamGetIntBefore('\n');
         DBG("### Waited", millis() - startMillis, "ms for socket to open");
+        if (connection_status != 0) { clearDnsCache(host); }
         return (0 == connection_status);
       } else {
         DBG("### Waited", millis() - startMillis,
@@ -691,8 +762,10 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
       }
     } else {
       // use synchronous open
-      sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port);
+      sendAT(GF("+USOCO="), *mux, ",\"", addr, "\",", port);
       int8_t rsp = waitResponse(timeout_ms - (millis() - startMillis));
+      // In case the host has moved
+      if (rsp != 1) { clearDnsCache(host); }
       return (1 == rsp);
     }
   }
@@ -702,7 +775,7 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
     if (waitResponse(GF("@")) != 1) { return 0; }
     // 50ms delay, see AT manual section 25.10.4
     delay(50);
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) { return 0; }
     streamSkipUntil(',');  // Skip mux
@@ -775,7 +848,6 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -786,79 +858,13 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+UUSORD:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-            // max size is 1024
-            if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
-          }
-          data = "";
-          DBG("### URC Data Received:", len, "on", mux);
-        } else if (data.endsWith(GF("+UUSOCL:"))) {
-          int8_t mux = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### URC Sock Closed: ", mux);
-        } else if (data.endsWith(GF("+UUSOCO:"))) {
-          int8_t mux          = streamGetIntBefore('\n');
-          int8_t socket_error = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
-              socket_error == 0) {
-            sockets[mux]->sock_connected = true;
-          }
-          data = "";
-          DBG("### URC Sock Opened: ", mux);
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -871,8 +877,14 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -887,6 +899,60 @@ class TinyGsmSaraR4 : public TinyGsmModem<TinyGsmSaraR4>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmSaraR4>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmSaraR4> table[] = {
+        {GSM_URC_UUSORD, &TinyGsmSaraR4::handleUusord},
+        {GSM_URC_UUSOCL, &TinyGsmSaraR4::handleUusocl},
+        {GSM_URC_UUSOCO, &TinyGsmSaraR4::handleUusoco},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +UUSORD:
+  bool handleUusord(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+      // max size is 1024
+      if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
+    }
+    DBG("### URC Data Received:", len, "on", mux);
+    return true;
+  }
+
+  // +UUSOCL:
+  bool handleUusocl(const char*, String*) {
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### URC Sock Closed: ", mux);
+    return true;
+  }
+
+  // +UUSOCO:
+  bool handleUusoco(const char*, String*) {
+    int8_t mux          = streamGetIntBefore(',');
+    int8_t socket_error = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux] &&
+        socket_error == 0) {
+      sockets[mux]->sock_connected = true;
+    }
+    connectFinished(mux, socket_error == 0);
+    dnsConnectFinished(mux, socket_error == 0);
+    DBG("### URC Sock Opened: ", mux);
+    return true;
+  }
+
  public:
   Stream& stream;
 
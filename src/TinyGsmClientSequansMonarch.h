@@ -13,7 +13,14 @@
 
 #define TINY_GSM_MUX_COUNT 6
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1500
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1500
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmCalling.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmModem.tpp"
@@ -30,6 +37,8 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_SQNSRING[] TINY_GSM_PROGMEM = GSM_NL "+SQNSRING:";
+static const char GSM_URC_SQNSH[] TINY_GSM_PROGMEM    = "SQNSH: ";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -53,6 +62,7 @@ enum SocketStatus {
 
 class TinyGsmSequansMonarch
     : public TinyGsmModem<TinyGsmSequansMonarch>,
+      public TinyGsmAsync<TinyGsmSequansMonarch>,
       public TinyGsmGPRS<TinyGsmSequansMonarch>,
       public TinyGsmTCP<TinyGsmSequansMonarch, TINY_GSM_MUX_COUNT>,
       public TinyGsmSSL<TinyGsmSequansMonarch>,
@@ -61,6 +71,7 @@ class TinyGsmSequansMonarch
       public TinyGsmTime<TinyGsmSequansMonarch>,
       public TinyGsmTemperature<TinyGsmSequansMonarch> {
   friend class TinyGsmModem<TinyGsmSequansMonarch>;
+  friend class TinyGsmAsync<TinyGsmSequansMonarch>;
   friend class TinyGsmGPRS<TinyGsmSequansMonarch>;
   friend class TinyGsmTCP<TinyGsmSequansMonarch, TINY_GSM_MUX_COUNT>;
   friend class TinyGsmSSL<TinyGsmSequansMonarch>;
@@ -114,6 +125,7 @@ class TinyGsmSequansMonarch
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+SQNSH="), mux);
       sock_connected = false;
@@ -512,7 +524,7 @@ class TinyGsmSequansMonarch
     char char_command[2];
     for (int i=0; i<len; i++) {
       memset(&char_command, 0, sizeof(char_command));
-      sprintf(&char_command[0], "%02X", reinterpret_cast<const uint8_t*>(buff)[i]);
+      sprintf(&char_command[0], "%02X", payloadByte(buff, i));
       stream.write(char_command, sizeof(char_command));
     }
     stream.flush();
@@ -550,15 +562,8 @@ class TinyGsmSequansMonarch
     if (waitResponse(GF("+SQNSRECV: ")) != 1) { return 0; }
     streamSkipUntil(',');  // Skip mux
     int16_t len = streamGetIntBefore('\n');
-    for (int i = 0; i < len; i++) {
-      uint32_t startMillis = millis();
-      while (!stream.available() &&
-             ((millis() - startMillis) <
-              sockets[mux % TINY_GSM_MUX_COUNT]->_timeout)) {
-        TINY_GSM_YIELD();
-      }
-      char c = stream.read();
-      sockets[mux % TINY_GSM_MUX_COUNT]->rx.put(c);
+    if (len > 0) {
+      moveCharsFromStreamToFifo(mux % TINY_GSM_MUX_COUNT, len);
     }
     // DBG("### READ:", len, "from", mux);
     waitResponse();
@@ -617,7 +622,6 @@ class TinyGsmSequansMonarch
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -628,71 +632,13 @@ class TinyGsmSequansMonarch
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+SQNSRING:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT &&
-              sockets[mux % TINY_GSM_MUX_COUNT]) {
-            sockets[mux % TINY_GSM_MUX_COUNT]->got_data       = true;
-            sockets[mux % TINY_GSM_MUX_COUNT]->sock_available = len;
-          }
-          data = "";
-          DBG("### URC Data Received:", len, "on", mux);
-        } else if (data.endsWith(GF("SQNSH: "))) {
-          int8_t mux = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT &&
-              sockets[mux % TINY_GSM_MUX_COUNT]) {
-            sockets[mux % TINY_GSM_MUX_COUNT]->sock_connected = false;
-          }
-          data = "";
-          DBG("### URC Sock Closed: ", mux);
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -705,8 +651,14 @@ class TinyGsmSequansMonarch
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -721,6 +673,46 @@ class TinyGsmSequansMonarch
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmSequansMonarch>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmSequansMonarch> table[] = {
+        {GSM_URC_SQNSRING, &TinyGsmSequansMonarch::handleSqnsring},
+        {GSM_URC_SQNSH, &TinyGsmSequansMonarch::handleSqnsh},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +SQNSRING:
+  bool handleSqnsring(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT &&
+        sockets[mux % TINY_GSM_MUX_COUNT]) {
+      sockets[mux % TINY_GSM_MUX_COUNT]->got_data       = true;
+      sockets[mux % TINY_GSM_MUX_COUNT]->sock_available = len;
+    }
+    DBG("### URC Data Received:", len, "on", mux);
+    return true;
+  }
+
+  // SQNSH:
+  bool handleSqnsh(const char*, String*) {
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT &&
+        sockets[mux % TINY_GSM_MUX_COUNT]) {
+      sockets[mux % TINY_GSM_MUX_COUNT]->sock_connected = false;
+    }
+    DBG("### URC Sock Closed: ", mux);
+    return true;
+  }
+
  public:
   Stream& stream;
 
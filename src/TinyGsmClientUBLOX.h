@@ -13,10 +13,26 @@
 // #define TINY_GSM_DEBUG Serial
 
 #define TINY_GSM_MUX_COUNT 7
+#define TINY_GSM_MODEM_HAS_CMUX
 #define TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+#define TINY_GSM_MODEM_HAS_CONNECT_ASYNC
+#define TINY_GSM_DATA_MODE_END "DISCONNECT"
+#if !defined(TINY_GSM_MAX_READ)
+#define TINY_GSM_MAX_READ 1024
+#endif
+#if !defined(TINY_GSM_MAX_SEND)
+#define TINY_GSM_MAX_SEND 1024
+#endif
+#if !defined(TINY_GSM_POLL_MAX)
+// +UUSORD is sent with the unread count each time data arrives, so polling
+// is only a safety net
+#define TINY_GSM_POLL_MAX 30000
+#endif
 
+#include "TinyGsmAsync.tpp"
 #include "TinyGsmBattery.tpp"
 #include "TinyGsmCalling.tpp"
+#include "TinyGsmDNS.tpp"
 #include "TinyGsmGPRS.tpp"
 #include "TinyGsmGPS.tpp"
 #include "TinyGsmGSMLocation.tpp"
@@ -25,6 +41,8 @@
 #include "TinyGsmSSL.tpp"
 #include "TinyGsmTCP.tpp"
 #include "TinyGsmTime.tpp"
+#include "TinyGsmTransparent.tpp"
+#include "TinyGsmUDP.tpp"
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM    = "OK" GSM_NL;
@@ -33,6 +51,10 @@ static const char GSM_ERROR[] TINY_GSM_PROGMEM = "ERROR" GSM_NL;
 static const char GSM_CME_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CME ERROR:";
 static const char GSM_CMS_ERROR[] TINY_GSM_PROGMEM = GSM_NL "+CMS ERROR:";
 #endif
+static const char GSM_URC_UUSORD[] TINY_GSM_PROGMEM = "+UUSORD:";
+static const char GSM_URC_UUSOCL[] TINY_GSM_PROGMEM = "+UUSOCL:";
+static const char GSM_URC_UUSOCO[] TINY_GSM_PROGMEM = "+UUSOCO:";
+static const char GSM_URC_UUSORF[] TINY_GSM_PROGMEM = "+UUSORF:";
 
 enum RegStatus {
   REG_NO_RESULT    = -1,
@@ -44,19 +66,28 @@ enum RegStatus {
   REG_UNKNOWN      = 4,
 };
 
-class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
-                     public TinyGsmGPRS<TinyGsmUBLOX>,
-                     public TinyGsmTCP<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>,
-                     public TinyGsmSSL<TinyGsmUBLOX>,
-                     public TinyGsmCalling<TinyGsmUBLOX>,
-                     public TinyGsmSMS<TinyGsmUBLOX>,
-                     public TinyGsmGSMLocation<TinyGsmUBLOX>,
-                     public TinyGsmGPS<TinyGsmUBLOX>,
-                     public TinyGsmTime<TinyGsmUBLOX>,
-                     public TinyGsmBattery<TinyGsmUBLOX> {
+class TinyGsmUBLOX
+    : public TinyGsmModem<TinyGsmUBLOX>,
+      public TinyGsmAsync<TinyGsmUBLOX>,
+      public TinyGsmGPRS<TinyGsmUBLOX>,
+      public TinyGsmTCP<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>,
+      public TinyGsmDNS<TinyGsmUBLOX>,
+      public TinyGsmUDP<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>,
+      public TinyGsmTransparent<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>,
+      public TinyGsmSSL<TinyGsmUBLOX>,
+      public TinyGsmCalling<TinyGsmUBLOX>,
+      public TinyGsmSMS<TinyGsmUBLOX>,
+      public TinyGsmGSMLocation<TinyGsmUBLOX>,
+      public TinyGsmGPS<TinyGsmUBLOX>,
+      public TinyGsmTime<TinyGsmUBLOX>,
+      public TinyGsmBattery<TinyGsmUBLOX> {
   friend class TinyGsmModem<TinyGsmUBLOX>;
+  friend class TinyGsmAsync<TinyGsmUBLOX>;
   friend class TinyGsmGPRS<TinyGsmUBLOX>;
   friend class TinyGsmTCP<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmDNS<TinyGsmUBLOX>;
+  friend class TinyGsmUDP<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>;
+  friend class TinyGsmTransparent<TinyGsmUBLOX, TINY_GSM_MUX_COUNT>;
   friend class TinyGsmSSL<TinyGsmUBLOX>;
   friend class TinyGsmCalling<TinyGsmUBLOX>;
   friend class TinyGsmSMS<TinyGsmUBLOX>;
@@ -115,7 +146,29 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
     }
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
 
+    // Starts opening the connection and returns without waiting for it, so
+    // several clients can connect at the same time.  connecting() stays true
+    // until the modem reports back.
+    // Returns false if the modem refused to start.
+    bool connectAsync(const char* host, uint16_t port, int timeout_s = 120) {
+      TINY_GSM_YIELD();
+      rx.clear();
+      startConnect(timeout_s);
+
+      uint8_t oldMux   = mux;
+      bool    accepted = at->modemConnect(host, port, &mux, false, timeout_s,
+                                          true);
+      if (mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", mux);
+        at->sockets[oldMux] = NULL;
+      }
+      at->sockets[mux] = this;
+
+      return connectStarted(accepted);
+    }
+
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       dumpModemBuffer(maxWaitMs);
       at->sendAT(GF("+USOCL="), mux);
       at->waitResponse();  // should return within 1s
@@ -161,6 +214,18 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
     TINY_GSM_CLIENT_CONNECT_OVERRIDES
   };
 
+  /*
+   * Inner UDP Socket
+   */
+ public:
+  typedef GsmUDP<GsmClientUBLOX> GsmUDPUBLOX;
+
+  /*
+   * Inner Transparent Client
+   */
+ public:
+  typedef GsmClientTransparent<GsmClientUBLOX> GsmClientTransparentUBLOX;
+
   /*
    * Constructor
    */
@@ -623,13 +688,35 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
   // (TOBY-L)
   float getTemperatureImpl() TINY_GSM_ATTR_NOT_IMPLEMENTED;
 
+  /*
+   * DNS functions
+   */
+ protected:
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    // AT+UDNSRN=<resolution_type>,<domain_ip_string>
+    // <resolution_type> - 0 for a name to an address
+    sendAT(GF("+UDNSRN=0,\""), host, '"');
+    if (waitResponse(timeout_ms, GF(GSM_NL "+UDNSRN:")) != 1) { return ""; }
+    streamSkipUntil('"');
+    String res = stream.readStringUntil('"');
+    waitResponse();
+    return res;
+  }
+
   /*
    * Client related functions
    */
  protected:
+  // With async set, opens the socket with +USOCO's asynchronous flag and
+  // returns once the modem has taken the command, leaving the +UUSOCO to the
+  // URC handler
   bool modemConnect(const char* host, uint16_t port, uint8_t* mux,
-                    bool ssl = false, int timeout_s = 120) {
-    uint32_t timeout_ms  = ((uint32_t)timeout_s) * 1000;
+                    bool ssl = false, int timeout_s = 120,
+                    bool async = false) {
+    uint32_t timeout_ms = ((uint32_t)timeout_s) * 1000;
+    // A host looked up before goes by its address; SSL needs the name itself
+    String addr = ssl ? String(host) : dnsConnectHost(host, timeout_ms, async);
+
     uint32_t startMillis = millis();
 
     // create a socket
@@ -657,17 +744,91 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
     // waitResponse();
 
     // connect on the allocated socket
-    sendAT(GF("+USOCO="), *mux, ",\"", host, "\",", port);
+    if (async) {
+      sendAT(GF("+USOCO="), *mux, ",\"", addr, "\",", port, ",1");
+      return dnsConnectStarted(host, *mux, waitResponse() == 1);
+    }
+    sendAT(GF("+USOCO="), *mux, ",\"", addr, "\",", port);
     int8_t rsp = waitResponse(timeout_ms - (millis() - startMillis));
+    // In case the host has moved
+    if (rsp != 1) { clearDnsCache(host); }
     return (1 == rsp);
   }
 
+  // Connects as usual and then puts the socket in direct link mode
+  bool modemConnectTransparent(const char* host, uint16_t port, uint8_t* mux,
+                               int timeout_s = 120) {
+    if (!modemConnect(host, port, mux, false, timeout_s)) { return false; }
+    return modemEnterDataMode(*mux);
+  }
+
+  // Direct link mode, which "+++" leaves with the socket still open
+  bool modemEnterDataMode(uint8_t mux) {
+    sendAT(GF("+USODL="), mux);
+    if (waitResponse(GF(GSM_NL "CONNECT"), GF("ERROR")) != 1) { return false; }
+    // The data starts after the end of the line
+    streamSkipUntil('\n');
+    return true;
+  }
+
+  // A UDP socket sends to and hears from any address
+  bool modemOpenUdp(const char*, uint16_t, uint16_t localPort, uint8_t* mux) {
+    if (localPort) {
+      sendAT(GF("+USOCR=17,"), localPort);
+    } else {
+      sendAT(GF("+USOCR=17"));
+    }
+    if (waitResponse(GF(GSM_NL "+USOCR:")) != 1) { return false; }
+    *mux = streamGetIntBefore('\n');
+    return waitResponse() == 1;
+  }
+
+  // The modem only sends to an address, so a name is looked up (or found in
+  // the cache) first
+  int16_t modemSendTo(const char* host, uint16_t port, const void* buff,
+                      size_t len, uint8_t mux) {
+    uint32_t timeout_ms = TINY_GSM_DNS_TIMEOUT;
+    String   addr       = dnsConnectHost(host, timeout_ms);
+    sendAT(GF("+USOST="), mux, ",\"", addr, "\",", port, ',', (uint16_t)len);
+    if (waitResponse(GF("@")) != 1) { return 0; }
+    // 50ms delay, see AT manual section 25.10.4
+    delay(50);
+    streamWritePayload(buff, len);
+    stream.flush();
+    if (waitResponse(GF(GSM_NL "+USOST:")) != 1) { return 0; }
+    streamSkipUntil(',');  // Skip mux
+    int16_t sent = streamGetIntBefore('\n');
+    waitResponse();
+    return sent;
+  }
+
+  // Each +USORF gives one datagram and its sender
+  size_t modemReadFrom(size_t size, uint8_t mux, IPAddress* ip,
+                       uint16_t* port) {
+    if (!sockets[mux]) return 0;
+    sendAT(GF("+USORF="), mux, ',', (uint16_t)size);
+    // +USORF: <mux>,"<remote ip>",<remote port>,<len>,"<data>"
+    if (waitResponse(GF(GSM_NL "+USORF:")) != 1) { return 0; }
+    streamSkipUntil('\"');
+    ip->fromString(stream.readStringUntil('\"'));
+    streamSkipUntil(',');
+    *port       = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore(',');
+    streamSkipUntil('\"');
+
+    if (len > 0) { moveCharsFromStreamToFifo(mux, len); }
+    streamSkipUntil('\"');
+    waitResponse();
+    sockets[mux]->sock_available = modemGetAvailable(mux);
+    return len > 0 ? len : 0;
+  }
+
   int16_t modemSend(const void* buff, size_t len, uint8_t mux) {
     sendAT(GF("+USOWR="), mux, ',', (uint16_t)len);
     if (waitResponse(GF("@")) != 1) { return 0; }
     // 50ms delay, see AT manual section 25.10.4
     delay(50);
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
     if (waitResponse(GF(GSM_NL "+USOWR:")) != 1) { return 0; }
     streamSkipUntil(',');  // Skip mux
@@ -694,10 +855,17 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
 
   size_t modemGetAvailable(uint8_t mux) {
     if (!sockets[mux]) return 0;
+    // UDP sockets are read with +USORF, and have no connection to check
+    bool udp = sockets[mux]->sock_udp;
     // NOTE:  Querying a closed socket gives an error "operation not allowed"
-    sendAT(GF("+USORD="), mux, ",0");
+    if (udp) {
+      sendAT(GF("+USORF="), mux, ",0");
+    } else {
+      sendAT(GF("+USORD="), mux, ",0");
+    }
     size_t  result = 0;
-    uint8_t res    = waitResponse(GF(GSM_NL "+USORD:"));
+    uint8_t res    = waitResponse(udp ? GF(GSM_NL "+USORF:")
+                                      : GF(GSM_NL "+USORD:"));
     // Will give error "operation not allowed" when attempting to read a socket
     // that you have already told to close
     if (res == 1) {
@@ -706,7 +874,9 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
       // if (result) DBG("### DATA AVAILABLE:", result, "on", mux);
       waitResponse();
     }
-    if (!result) { sockets[mux]->sock_connected = modemGetConnected(mux); }
+    if (!result && !udp) {
+      sockets[mux]->sock_connected = modemGetConnected(mux);
+    }
     // DBG("### AvailablE:", result, "on", mux);
     return result;
   }
@@ -740,7 +910,6 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
    * Utilities
    */
  public:
-  // TODO(vshymanskyy): Optimize this!
   int8_t waitResponse(uint32_t timeout_ms, String& data,
                       GsmConstStr r1 = GFP(GSM_OK),
                       GsmConstStr r2 = GFP(GSM_ERROR),
@@ -751,70 +920,13 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
-    data.reserve(64);
-    uint8_t  index       = 0;
-    uint32_t startMillis = millis();
-    do {
-      TINY_GSM_YIELD();
-      while (stream.available() > 0) {
-        TINY_GSM_YIELD();
-        int8_t a = stream.read();
-        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
-        data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    int8_t      index = waitResponseImpl(timeout_ms, &data, responses, 5);
 #if defined TINY_GSM_DEBUG
-          if (r3 == GFP(GSM_CME_ERROR)) {
-            streamSkipUntil('\n');  // Read out the error
-          }
-#endif
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        } else if (data.endsWith(GF("+UUSORD:"))) {
-          int8_t  mux = streamGetIntBefore(',');
-          int16_t len = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->got_data = true;
-            // max size is 1024
-            if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
-          }
-          data = "";
-          // DBG("### URC Data Received:", len, "on", mux);
-        } else if (data.endsWith(GF("+UUSOCL:"))) {
-          int8_t mux = streamGetIntBefore('\n');
-          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
-            sockets[mux]->sock_connected = false;
-          }
-          data = "";
-          DBG("### URC Sock Closed: ", mux);
-        }
-      }
-    } while (millis() - startMillis < timeout_ms);
-  finish:
-    if (!index) {
-      data.trim();
-      if (data.length()) { DBG("### Unhandled:", data); }
-      data = "";
+    if (index == 3 && r3 == GFP(GSM_CME_ERROR)) {
+      streamSkipUntil('\n');  // Read out the error
     }
-    // data.replace(GSM_NL, "/");
-    // DBG('<', index, '>', data);
+#endif
     return index;
   }
 
@@ -827,8 +939,14 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
                       GsmConstStr r3 = NULL, GsmConstStr r4 = NULL,
 #endif
                       GsmConstStr r5 = NULL) {
+#if defined TINY_GSM_DEBUG
+    // Hang on to the text so anything unexpected can be logged
     String data;
     return waitResponse(timeout_ms, data, r1, r2, r3, r4, r5);
+#else
+    GsmConstStr responses[] = {r1, r2, r3, r4, r5};
+    return waitResponseImpl(timeout_ms, NULL, responses, 5);
+#endif
   }
 
   int8_t waitResponse(GsmConstStr r1 = GFP(GSM_OK),
@@ -843,6 +961,56 @@ class TinyGsmUBLOX : public TinyGsmModem<TinyGsmUBLOX>,
     return waitResponse(1000, r1, r2, r3, r4, r5);
   }
 
+  /*
+   * Unsolicited result codes
+   */
+ protected:
+  // The URC's waitResponse() watches for and the handler for each of them
+  static const TinyGsmUrc<TinyGsmUBLOX>* urcTable() {
+    static constexpr TinyGsmUrc<TinyGsmUBLOX> table[] = {
+        {GSM_URC_UUSORD, &TinyGsmUBLOX::handleUusord},
+        {GSM_URC_UUSORF, &TinyGsmUBLOX::handleUusord},
+        {GSM_URC_UUSOCL, &TinyGsmUBLOX::handleUusocl},
+        {GSM_URC_UUSOCO, &TinyGsmUBLOX::handleUusoco},
+        {NULL, NULL}};
+    return table;
+  }
+
+  // Each handler reads out the rest of its URC and returns false if the text
+  // read so far should be left in the response instead
+
+  // +UUSORD:, or +UUSORF: for a UDP socket
+  bool handleUusord(const char*, String*) {
+    int8_t  mux = streamGetIntBefore(',');
+    int16_t len = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+      // max size is 1024
+      if (len >= 0 && len <= 1024) { sockets[mux]->sock_available = len; }
+    }
+    // DBG("### URC Data Received:", len, "on", mux);
+    return true;
+  }
+
+  // +UUSOCL:
+  bool handleUusocl(const char*, String*) {
+    int8_t mux = streamGetIntBefore('\n');
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->sock_connected = false;
+    }
+    DBG("### URC Sock Closed: ", mux);
+    return true;
+  }
+
+  // +UUSOCO:, after a connectAsync()
+  bool handleUusoco(const char*, String*) {
+    int8_t mux          = streamGetIntBefore(',');
+    int8_t socket_error = streamGetIntBefore('\n');
+    connectFinished(mux, socket_error == 0);
+    dnsConnectFinished(mux, socket_error == 0);
+    return true;
+  }
+
  public:
   Stream& stream;
 
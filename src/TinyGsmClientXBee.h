@@ -14,8 +14,19 @@
 // #define TINY_GSM_DEBUG Serial
 
 // XBee's do not support multi-plexing in transparent/command mode
-// The much more complicated API mode is needed for multi-plexing
+// The much more complicated API mode is needed for multi-plexing.  Define
+// TINY_GSM_XBEE_API_MODE as 1 (or as 2, for escaped frames) before including
+// TinyGsmClient.h to use it.
+#if defined(TINY_GSM_XBEE_API_MODE)
+#if TINY_GSM_XBEE_API_MODE != 1 && TINY_GSM_XBEE_API_MODE != 2
+#error TINY_GSM_XBEE_API_MODE must be 1 or 2
+#endif
+#define TINY_GSM_MUX_COUNT 6
+#define TINY_GSM_XBEE_AP TINY_GSM_XBEE_API_MODE
+#else
 #define TINY_GSM_MUX_COUNT 1
+#define TINY_GSM_XBEE_AP 0
+#endif
 #define TINY_GSM_NO_MODEM_BUFFER
 // XBee's have a default guard time of 1 second (1000ms, 10 extra for safety
 // here)
@@ -66,6 +77,32 @@ enum XBeeType {
   XBEE3_LTEM_ATT = 0xB08,  // Digi XBee3 Cellular LTE-M
 };
 
+#if defined(TINY_GSM_XBEE_API_MODE)
+// The API frame types used
+enum XBeeApiFrame {
+  XBEE_API_AT           = 0x08,  // Local AT command request
+  XBEE_API_SMS          = 0x1F,  // Transmit SMS
+  XBEE_API_TX_IPV4      = 0x20,  // Transmit request: IPv4
+  XBEE_API_SOCK_CREATE  = 0x40,  // Socket create (XBee3 Cellular)
+  XBEE_API_SOCK_CONNECT = 0x42,  // Socket connect
+  XBEE_API_SOCK_CLOSE   = 0x43,  // Socket close
+  XBEE_API_SOCK_SEND    = 0x44,  // Socket send
+  XBEE_API_AT_RESP      = 0x88,  // Local AT command response
+  XBEE_API_TX_STATUS    = 0x89,  // Transmit status
+  XBEE_API_RX_IPV4      = 0xB0,  // RX packet: IPv4
+  XBEE_API_CREATE_RESP  = 0xC0,  // Socket create response
+  XBEE_API_CONNECT_RESP = 0xC2,  // Socket connect response
+  XBEE_API_CLOSE_RESP   = 0xC3,  // Socket close response
+  XBEE_API_SOCK_RECEIVE = 0xCD,  // Socket receive
+  XBEE_API_SOCK_STATUS  = 0xCF,  // Socket status
+};
+
+// The registers whose values are text, the last four of them IP addresses,
+// in pairs.  All other values go in frames as big-endian numbers.
+static const char XBEE_API_TEXT[] TINY_GSM_PROGMEM =
+    "IDPKANCUCWPNPHMNIMIIS#NILADLMYOD";
+#endif
+
 class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
                     public TinyGsmGPRS<TinyGsmXBee>,
                     public TinyGsmWifi<TinyGsmXBee>,
@@ -97,12 +134,14 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
       init(&modem, mux);
     }
 
-    bool init(TinyGsmXBee* modem, uint8_t = 0) {
+    bool init(TinyGsmXBee* modem, uint8_t mux = 0) {
       this->at       = modem;
-      this->mux      = 0;
+      sock_available = 0;
       sock_connected = false;
 
-      at->sockets[0] = this;
+      // Only API mode has more than the one socket
+      this->mux              = mux % TINY_GSM_MUX_COUNT;
+      at->sockets[this->mux] = this;
 
       return true;
     }
@@ -138,11 +177,13 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     }
 
     void stop(uint32_t maxWaitMs) {
+      flushTx();
       at->streamClear();  // Empty anything in the buffer
       // empty the saved currently-in-use destination address
-      at->modemStop(maxWaitMs);
+      at->modemStop(maxWaitMs, mux);
       at->streamClear();  // Empty anything in the buffer
       sock_connected = false;
+      rx.clear();
 
       // Note:  because settings are saved in flash, the XBEE will attempt to
       // reconnect to the previous socket if it receives any outgoing data.
@@ -154,6 +195,10 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
       stop(5000L);
     }
 
+#if !defined(TINY_GSM_XBEE_API_MODE)
+    // In API mode the data comes in frames that maintain() sorts into each
+    // socket's FIFO, so the usual client functions are used.  In transparent
+    // mode everything on the line is the socket's.
     size_t write(const uint8_t* buf, size_t size) override {
       TINY_GSM_YIELD();
       return at->modemSend(buf, size, mux);
@@ -237,12 +282,23 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     operator bool() override {
       return connected();
     }
+#endif
 
     /*
      * Extended API
      */
 
     String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
+
+#if defined(TINY_GSM_XBEE_API_MODE)
+   protected:
+    // The XBee3 Cellular's own number for the socket, once it has made one
+    uint8_t sock_id = 0xFF;
+    // The far end, for the XBee's that send to an address instead
+    IPAddress sock_ip;
+    uint16_t  sock_port  = 0;
+    uint8_t   sock_proto = 0;
+#endif
   };
 
   /*
@@ -295,7 +351,10 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
         savedHostIP(IPAddress(0, 0, 0, 0)),
         savedOperatingIP(IPAddress(0, 0, 0, 0)),
         inCommandMode(false),
-        lastCommandModeMillis(0) {
+        lastCommandModeMillis(0),
+        inConfig(false),
+        configChanged(false),
+        apiMode(false) {
     // Start not knowing what kind of bee it is
     // Start with the default guard time of 1 second
     memset(sockets, 0, sizeof(sockets));
@@ -311,7 +370,10 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
         savedHostIP(IPAddress(0, 0, 0, 0)),
         savedOperatingIP(IPAddress(0, 0, 0, 0)),
         inCommandMode(false),
-        lastCommandModeMillis(0) {
+        lastCommandModeMillis(0),
+        inConfig(false),
+        configChanged(false),
+        apiMode(false) {
     // Start not knowing what kind of bee it is
     // Start with the default guard time of 1 second
     memset(sockets, 0, sizeof(sockets));
@@ -344,8 +406,9 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
       }
     }
 
-    // Put in transparent mode, if it isn't already
-    changesMade |= changeSettingIfNeeded(GF("AP"), 0x0);
+    // Put in transparent (or API) mode, if it isn't already.  API mode takes
+    // over on leaving command mode.
+    changesMade |= changeSettingIfNeeded(GF("AP"), TINY_GSM_XBEE_AP);
 
     // shorten the guard time to 100ms, if it was anything else
     sendAT(GF("GT"));
@@ -371,6 +434,11 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
 
     XBEE_COMMAND_END_DECORATOR
 
+#if defined(TINY_GSM_XBEE_API_MODE)
+    // From here on every command goes in a frame, or from commitConfig() on
+    if (!inConfig) { apiMode = ret_val; }
+#endif
+
     return ret_val;
   }
 
@@ -407,7 +475,11 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     uint32_t start   = millis();
     bool     success = false;
     while (!success && millis() - start < timeout_ms) {
-      if (!inCommandMode) {
+      if (apiMode) {
+        // Any answer to a frame will do
+        sendAT(GF("AP"));
+        success = readResponseString(200) != "";
+      } else if (!inCommandMode) {
         success = commandMode();
         if (success) exitCommand();
       } else {
@@ -425,6 +497,12 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   }
 
   void maintainImpl() {
+#if defined(TINY_GSM_XBEE_API_MODE)
+    // In API mode the socket data and status come in frames
+    if (apiMode) {
+      while (stream.available()) { apiPoll(); }
+    }
+#endif
     // this only happens OUTSIDE command mode, so if we're getting characters
     // they should be data received from the TCP connection
     // TINY_GSM_YIELD();
@@ -445,6 +523,8 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     // Make sure the guard time for the modem object is set back to default
     // otherwise communication would fail after the reset
     guardTime = 1010;
+    // The reset also puts it back in transparent mode
+    if (!inConfig) { apiMode = false; }
     return ret_val;
   }
 
@@ -491,6 +571,42 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     }
   }
 
+  // Starts one command mode session for several calls, ie:
+  //   modem.beginConfig();
+  //   modem.gprsConnect(apn);
+  //   client.connect(host, port);
+  //   modem.commitConfig();
+  // The calls in between share it rather than each paying the guard times
+  // into and out of command mode, and what they change is only written to
+  // flash and applied on commitConfig(), with one WR and AC.  Until then the
+  // XBee goes on with its old settings.
+  bool beginConfig() {
+    if (!commandMode()) { return false; }
+    inConfig = true;
+    return true;
+  }
+
+  // Writes and applies what was changed since beginConfig() and leaves
+  // command mode.  Returns false if the changes could not be written.
+  bool commitConfig() {
+    if (!inConfig) { return false; }
+    inConfig     = false;
+    bool success = true;
+    if (configChanged) { success = commandMode() && writeChanges(); }
+    configChanged = false;
+    if (!inCommandMode) { return success; }  // ie, sendSMS() left it
+#if defined(TINY_GSM_XBEE_API_MODE)
+    // Leaving command mode puts an XBee that init() set up in API mode
+    sendAT(GF("AP"));
+    bool api = readResponseInt() == TINY_GSM_XBEE_API_MODE;
+#endif
+    exitCommand();
+#if defined(TINY_GSM_XBEE_API_MODE)
+    apiMode = api;
+#endif
+    return success;
+  }
+
   /*
    * Power functions
    */
@@ -507,6 +623,9 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   }
 
   bool restartImpl(const char* pin = NULL) {
+    // Anything staged since beginConfig() is written first
+    if (inConfig) { commitConfig(); }
+
     if (!commandMode()) { return false; }  // Return immediately
 
     if (beeType == XBEE_UNKNOWN) getSeries();  // how we restart depends on this
@@ -531,8 +650,9 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
       delay(100);  // cellular modules wait 100ms before reset happens
 
     // Wait until reboot completes and XBee responds to command mode call again
+    // (or, in API mode, answers a frame)
     for (uint32_t start = millis(); millis() - start < 60000L;) {
-      if (commandMode(1)) break;
+      if (apiMode ? testAT(1000) : commandMode(1)) break;
       delay(250);  // wait a litle before trying again
     }
 
@@ -674,8 +794,9 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
             writeChanges();
             stat = REG_UNKNOWN;
             break;
-          case 0x2F:            // 0x2F Bypass mode active.
-            sendAT(GF("AP0"));  // Set back to transparent mode
+          case 0x2F:  // 0x2F Bypass mode active.
+            // Set back to transparent (or API) mode
+            sendAT(GF("AP"), TINY_GSM_XBEE_AP);
             waitResponse();
             writeChanges();
             stat = REG_UNKNOWN;
@@ -903,6 +1024,10 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   String sendUSSDImpl(const String& code) TINY_GSM_ATTR_NOT_AVAILABLE;
 
   bool sendSMSImpl(const String& number, const String& text) {
+#if defined(TINY_GSM_XBEE_API_MODE)
+    // In API mode the message goes in a frame of its own
+    if (apiMode) { return apiSendSMS(number, text); }
+#endif
     bool changesMade = false;
     if (!commandMode()) { return false; }  // Return immediately
 
@@ -1015,8 +1140,7 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
 
     XBEE_COMMAND_START_DECORATOR(5, IPAddress(0, 0, 0, 0))
     sendAT(GF("OD"));
-    strIP = stream.readStringUntil('\r');  // read result
-    strIP.trim();
+    strIP = readResponseString();  // read result
     XBEE_COMMAND_END_DECORATOR
 
     if (strIP != "" && strIP != GF("ERROR")) {
@@ -1039,11 +1163,10 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     // NOTE: the lookup can take a while
     while ((millis() - startMillis) < timeout_ms) {
       sendAT(GF("LA"), host);
-      while (stream.available() < 4 && (millis() - startMillis < timeout_ms)) {
+      while (responseAvailable() < 4 && (millis() - startMillis < timeout_ms)) {
         TINY_GSM_YIELD()
       }
-      strIP = stream.readStringUntil('\r');  // read result
-      strIP.trim();
+      strIP = readResponseString(0);  // read result
       if (strIP != "" && strIP != GF("ERROR")) {
         gotIP = true;
         break;
@@ -1060,6 +1183,7 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     }
   }
 
+#if !defined(TINY_GSM_XBEE_API_MODE)
   bool modemConnect(const char* host, uint16_t port, uint8_t mux = 0,
                     bool ssl = false, int timeout_s = 75) {
     bool retVal = false;
@@ -1145,7 +1269,7 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     return success;
   }
 
-  bool modemStop(uint32_t maxWaitMs) {
+  bool modemStop(uint32_t maxWaitMs, uint8_t = 0) {
     streamClear();  // Empty anything in the buffer
     // empty the saved currently-in-use destination address
     savedOperatingIP = IPAddress(0, 0, 0, 0);
@@ -1179,7 +1303,7 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     if (mux != 0) {
       DBG("XBee only supports 1 IP channel in transparent mode!");
     }
-    stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    streamWritePayload(buff, len);
     stream.flush();
 
     if (beeType != XBEE_S6B_WIFI) {
@@ -1327,18 +1451,181 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     }
   }
 
+#else
+  // In API mode the XBee3 Cellular makes sockets of its own, which connect
+  // to a host name.  The S6B Wi-Fi and the older cellular XBee's instead send
+  // each frame to an address, opening the TCP connection with the first.
+  bool modemConnect(const char* host, uint16_t port, uint8_t mux = 0,
+                    bool ssl = false, int timeout_s = 75) {
+    GsmClientXBee* sock = sockets[mux];
+    if (!apiMode || !sock) { return false; }
+    modemStop(5000L, mux);
+    sock->rx.clear();
+
+    if (beeType == XBEE_UNKNOWN) getSeries();
+
+    if (!apiHasSockets()) {
+      IPAddress ip = TinyGsmIpFromString(host);
+      for (const char* p = host; *p; p++) {
+        if ((*p < '0' || *p > '9') && *p != '.') {
+          // These need a numeric IP address
+          ip = lookupHostIP(host, timeout_s);
+          break;
+        }
+      }
+      if (ip == IPAddress(0, 0, 0, 0)) { return false; }
+      sock->sock_ip    = ip;
+      sock->sock_port  = port;
+      sock->sock_proto = ssl ? 0x04 : 0x01;  // SSL or TCP
+      return true;
+    }
+
+    uint8_t id = apiStart(XBEE_API_SOCK_CREATE, 1);
+    apiWrite(ssl ? 0x04 : 0x01);  // TLS or TCP
+    apiEnd();
+    if (!apiWaitFrame(XBEE_API_CREATE_RESP, id, 5000L) || apiLastStatus) {
+      return false;
+    }
+    sock->sock_id = apiLastSock;
+
+    size_t len = strlen(host);
+    id         = apiStart(XBEE_API_SOCK_CONNECT, 4 + len);
+    apiWrite(sock->sock_id);
+    apiWrite(port >> 8);
+    apiWrite(port & 0xFF);
+    apiWrite(0x01);  // The address is a host name, looked up by the XBee
+    for (size_t i = 0; i < len; i++) { apiWrite(host[i]); }
+    apiEnd();
+    sock->sock_connecting = true;
+    if (!apiWaitFrame(XBEE_API_CONNECT_RESP, id, 5000L) || apiLastStatus) {
+      sock->sock_connecting = false;
+      modemStop(5000L, mux);
+      return false;
+    }
+
+    // It is connected once a socket status frame says so
+    uint32_t timeout_ms  = ((uint32_t)timeout_s) * 1000;
+    uint32_t startMillis = millis();
+    while (sock->sock_connecting && millis() - startMillis < timeout_ms) {
+      if (stream.available()) {
+        apiPoll();
+      } else {
+        TINY_GSM_YIELD();
+      }
+    }
+    if (!sock->sock_connected) {
+      sock->sock_connecting = false;
+      modemStop(5000L, mux);
+    }
+    return sock->sock_connected;
+  }
+
+  bool modemConnect(IPAddress ip, uint16_t port, uint8_t mux = 0,
+                    bool ssl = false) {
+    return modemConnect(GsmClient::TinyGsmStringFromIp(ip).c_str(), port, mux,
+                        ssl);
+  }
+
+  bool modemStop(uint32_t maxWaitMs, uint8_t mux = 0) {
+    GsmClientXBee* sock = sockets[mux];
+    if (!apiMode || !sock) { return false; }
+    bool success = true;
+    if (sock->sock_id != 0xFF) {
+      uint8_t id = apiStart(XBEE_API_SOCK_CLOSE, 1);
+      apiWrite(sock->sock_id);
+      apiEnd();
+      success = apiWaitFrame(XBEE_API_CLOSE_RESP, id, maxWaitMs) &&
+                !apiLastStatus;
+      sock->sock_id = 0xFF;
+    } else if (sock->sock_port) {
+      // An empty frame, with the option to close the socket after it
+      success         = apiSendIPv4(sock, NULL, 0, 0x02, maxWaitMs);
+      sock->sock_port = 0;
+    }
+    sock->sock_connected = false;
+    return success;
+  }
+
+  int16_t modemSend(const void* buff, size_t len, uint8_t mux = 0) {
+    GsmClientXBee* sock = sockets[mux];
+    if (!apiMode || !sock || !sock->sock_connected) { return 0; }
+    bool sent;
+    if (sock->sock_id != 0xFF) {
+      uint8_t id = apiStart(XBEE_API_SOCK_SEND, 2 + len);
+      apiWrite(sock->sock_id);
+      apiWrite(0x00);  // Transmit options
+      for (size_t i = 0; i < len; i++) { apiWrite(payloadByte(buff, i)); }
+      apiEnd();
+      sent = apiWaitFrame(XBEE_API_TX_STATUS, id, 10000L) && !apiLastStatus;
+    } else {
+      sent = apiSendIPv4(sock, buff, len, 0x00, 10000L);
+      // With no socket status frames, a failed send is all there is to go on
+      if (!sent) { sock->sock_connected = false; }
+    }
+    if (!sent) { DBG("### Send failed:", apiLastStatus); }
+    return sent ? len : 0;
+  }
+
+  bool modemGetConnected(uint8_t mux) {
+    // The socket status frames keep sock_connected up to date
+    maintain();
+    return sockets[mux] && sockets[mux]->sock_connected;
+  }
+
+  bool apiSendIPv4(GsmClientXBee* sock, const void* buff, size_t len,
+                   uint8_t options, uint32_t timeout_ms) {
+    uint8_t id = apiStart(XBEE_API_TX_IPV4, 10 + len);
+    for (uint8_t i = 0; i < 4; i++) { apiWrite(sock->sock_ip[i]); }
+    apiWrite(sock->sock_port >> 8);
+    apiWrite(sock->sock_port & 0xFF);
+    apiWrite(0x00);  // Any source port
+    apiWrite(0x00);
+    apiWrite(sock->sock_proto);
+    apiWrite(options);
+    for (size_t i = 0; i < len; i++) { apiWrite(payloadByte(buff, i)); }
+    apiEnd();
+    return apiWaitFrame(XBEE_API_TX_STATUS, id, timeout_ms) && !apiLastStatus;
+  }
+
+  bool apiSendSMS(const String& number, const String& text) {
+    uint8_t id = apiStart(XBEE_API_SMS, 21 + text.length());
+    apiWrite(0x00);  // Options
+    // The number, padded out to 20 characters
+    for (uint8_t i = 0; i < 20; i++) {
+      apiWrite(i < number.length() ? number[i] : 0);
+    }
+    for (size_t i = 0; i < text.length(); i++) { apiWrite(text[i]); }
+    apiEnd();
+    return apiWaitFrame(XBEE_API_TX_STATUS, id, 60000L) && !apiLastStatus;
+  }
+
+  // The XBee3 Cellular makes sockets of its own, the others do not
+  bool apiHasSockets() {
+    return beeType != XBEE_S6B_WIFI && beeType != XBEE_LTE1_VZN &&
+           beeType != XBEE_3G;
+  }
+#endif
+
   /*
    * Utilities
    */
  public:
   void streamClear(void) {
+#if defined(TINY_GSM_XBEE_API_MODE)
+    // In API mode the frames are read rather than thrown away, as they may
+    // hold socket data
+    if (apiMode) {
+      while (stream.available()) { apiPoll(); }
+      apiResponse = "";
+      return;
+    }
+#endif
     while (stream.available()) {
       stream.read();
       TINY_GSM_YIELD();
     }
   }
 
-  // TODO(vshymanskyy): Optimize this!
   // NOTE:  This function is used while INSIDE command mode, so we're only
   // waiting for requested responses.  The XBee has no unsoliliced responses
   // (URC's) when in command mode.
@@ -1352,32 +1639,24 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
     String r4s(r4); r4s.trim();
     String r5s(r5); r5s.trim();
     DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
+    TinyGsmMatcher<5> matcher;
+    matcher.add(r1);
+    matcher.add(r2);
+    matcher.add(r3);
+    matcher.add(r4);
+    matcher.add(r5);
     data.reserve(16);  // Should never be getting much here for the XBee
     int8_t   index       = 0;
     uint32_t startMillis = millis();
     do {
       TINY_GSM_YIELD();
-      while (stream.available() > 0) {
+      while (responseAvailable() > 0) {
         TINY_GSM_YIELD();
-        int8_t a = stream.read();
+        int8_t a = responseRead();
         if (a <= 0) continue;  // Skip 0x00 bytes, just in case
         data += static_cast<char>(a);
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
-          goto finish;
-        }
+        index = matcher.feed(a);
+        if (index) { goto finish; }
       }
     } while (millis() - startMillis < timeout_ms);
   finish:
@@ -1395,6 +1674,8 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
       data.replace(GSM_NL GSM_NL, GSM_NL);
       data.replace(GSM_NL, "\r\n    ");
     }
+    // Each answer keeps the XBee in command mode for another CT
+    if (index && inCommandMode) { lastCommandModeMillis = millis(); }
     // data.replace(GSM_NL, "/");
     // DBG('<', index, '>', data);
     return index;
@@ -1414,6 +1695,12 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   }
 
   bool commandMode(uint8_t retries = 5) {
+    // In API mode the commands go in frames, with no guard times to wait out
+    if (apiMode) {
+      inCommandMode = true;
+      return true;
+    }
+
     // If we're already in command mode, move on
     if (inCommandMode && (millis() - lastCommandModeMillis) < 10000L)
       return true;
@@ -1450,6 +1737,12 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   }
 
   bool writeChanges(void) {
+    // Between beginConfig() and commitConfig() the changes are written once,
+    // at the end
+    if (inConfig) {
+      configChanged = true;
+      return true;
+    }
     sendAT(GF("WR"));  // Write changes to flash
     if (1 != waitResponse()) { return false; }
     sendAT(GF("AC"));  // Apply changes
@@ -1458,6 +1751,10 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   }
 
   void exitCommand(void) {
+    if (apiMode) {
+      inCommandMode = false;
+      return;
+    }
     // NOTE:  Here we explicitely try to exit command mode
     // even if the internal flag inCommandMode was already false
     sendAT(GF("CN"));  // Exit command mode
@@ -1480,10 +1777,20 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   String readResponseString(uint32_t timeout_ms = 1000) {
     TINY_GSM_YIELD();
     uint32_t startMillis = millis();
-    while (!stream.available() && millis() - startMillis < timeout_ms) {}
+    while (!responseAvailable() && millis() - startMillis < timeout_ms) {}
+#if defined(TINY_GSM_XBEE_API_MODE)
+    if (apiMode) {
+      // An AT response frame gives the one line
+      String res  = apiResponse;
+      apiResponse = "";
+      res.trim();
+      return res;
+    }
+#endif
     String res =
         stream.readStringUntil('\r');  // lines end with carriage returns
     res.trim();
+    if (res.length() && inCommandMode) { lastCommandModeMillis = millis(); }
     return res;
   }
 
@@ -1542,6 +1849,334 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
       return false;
   }
 
+  // Command responses come from the line in command mode, and from the AT
+  // response frames in API mode
+  int responseAvailable() {
+#if defined(TINY_GSM_XBEE_API_MODE)
+    if (apiMode) {
+      if (!apiResponse.length() && stream.available()) { apiPoll(); }
+      return apiResponse.length();
+    }
+#endif
+    return stream.available();
+  }
+
+  int responseRead() {
+#if defined(TINY_GSM_XBEE_API_MODE)
+    if (apiMode) {
+      if (!apiResponse.length()) { return -1; }
+      char c = apiResponse[0];
+      apiResponse.remove(0, 1);
+      return c;
+    }
+#endif
+    return stream.read();
+  }
+
+#if defined(TINY_GSM_XBEE_API_MODE)
+  /*
+   * API mode
+   */
+ public:
+  // In API mode the commands go in local AT command frames, with the same
+  // parameter text as in command mode: as it is for the registers that hold
+  // text, read as a hex number for all others
+  template <typename... Args>
+  inline void sendAT(Args... cmd) {
+    if (!apiMode) {
+      TinyGsmModem<TinyGsmXBee>::sendAT(cmd...);
+      return;
+    }
+    String text;
+    apiConcat(text, cmd...);
+    apiSendAT(text);
+  }
+
+ protected:
+  inline void apiConcat(String&) {}
+
+  template <typename T, typename... Args>
+  inline void apiConcat(String& text, T head, Args... tail) {
+    text += head;
+    apiConcat(text, tail...);
+  }
+
+  void apiSendAT(const String& text) {
+    if (text.length() < 2) { return; }
+    char    cmd[3] = {text[0], text[1], 0};
+    uint8_t reg    = apiRegister(cmd);
+    size_t  len    = text.length() - 2;
+    apiAtQuery     = !len;
+    apiResponse    = "";
+    // A number goes as big-endian bytes, two hex digits to each
+    apiAtId = apiStart(XBEE_API_AT, 2 + (reg ? len : (len + 1) / 2));
+    apiWrite(cmd[0]);
+    apiWrite(cmd[1]);
+    uint8_t b = 0;
+    for (size_t i = 0; i < len; i++) {
+      char c = text[2 + i];
+      if (reg) {
+        apiWrite(c);
+        continue;
+      }
+      b = (b << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+      if (!((len - 1 - i) & 1)) {
+        apiWrite(b);
+        b = 0;
+      }
+    }
+    apiEnd();
+  }
+
+  // Whether the register holds a number (0), text (1) or an IP address (2)
+  static uint8_t apiRegister(const char* cmd) {
+    const uint8_t count = (sizeof(XBEE_API_TEXT) - 1) / 2;
+    for (uint8_t i = 0; i < count; i++) {
+      if (TINY_GSM_PGM_BYTE(XBEE_API_TEXT + 2 * i) == cmd[0] &&
+          TINY_GSM_PGM_BYTE(XBEE_API_TEXT + 2 * i + 1) == cmd[1]) {
+        return i < count - 4 ? 1 : 2;
+      }
+    }
+    return 0;
+  }
+
+  // Starts a frame of the type, with len characters after the type and the
+  // frame ID.  Returns the frame ID.
+  uint8_t apiStart(uint8_t type, size_t len) {
+    if (++apiFrameId == 0) { apiFrameId = 1; }
+    len += 2;
+    stream.write(static_cast<uint8_t>(0x7E));
+    apiWrite(len >> 8);
+    apiWrite(len & 0xFF);
+    apiSum = 0;  // The length is not part of the checksum
+    apiWrite(type);
+    apiWrite(apiFrameId);
+    return apiFrameId;
+  }
+
+  // Writes a character of the frame, escaped if need be
+  void apiWrite(uint8_t c) {
+    apiSum += c;
+#if TINY_GSM_XBEE_API_MODE == 2
+    if (c == 0x7E || c == 0x7D || c == 0x11 || c == 0x13) {
+      stream.write(static_cast<uint8_t>(0x7D));
+      c ^= 0x20;
+    }
+#endif
+    stream.write(c);
+  }
+
+  void apiEnd() {
+    apiWrite(0xFF - apiSum);
+    stream.flush();
+  }
+
+  // Reads a character of a frame, undoing any escape.  Returns -1 if the
+  // frame stops short.
+  int apiRead() {
+    int c = apiTimedRead();
+#if TINY_GSM_XBEE_API_MODE == 2
+    if (c == 0x7D) {
+      c = apiTimedRead();
+      if (c >= 0) { c ^= 0x20; }
+    }
+#endif
+    if (c >= 0) { apiSum += c; }
+    return c;
+  }
+
+  int apiTimedRead() {
+    uint32_t startMillis = millis();
+    while (!stream.available()) {
+      if (millis() - startMillis > 100) { return -1; }
+      TINY_GSM_YIELD();
+    }
+    return stream.read();
+  }
+
+  bool apiReadBytes(uint8_t* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      int c = apiRead();
+      if (c < 0) { return false; }
+      buf[i] = c;
+    }
+    return true;
+  }
+
+  // Reads the frame the XBee has started to send, if any, handing socket
+  // data and status on as they come.  Returns the frame's type, or 0 if there
+  // was none or it was cut short or garbled.
+  uint8_t apiPoll() {
+    // Anything between frames is skipped
+    while (stream.available() && stream.peek() != 0x7E) { stream.read(); }
+    if (!stream.available()) { return 0; }
+    stream.read();
+    int hi   = apiRead();
+    int lo   = apiRead();
+    apiSum   = 0;
+    int type = apiRead();
+    if (hi < 0 || lo < 0 || type <= 0) { return 0; }
+    uint16_t len = ((hi << 8) | lo) - 1;
+
+    // The fixed part of the frames looked at
+    uint8_t hdr[10];
+    uint8_t need = 0;
+    switch (type) {
+      case XBEE_API_AT_RESP: need = 4; break;       // ID, command, status
+      case XBEE_API_TX_STATUS: need = 2; break;     // ID, status
+      case XBEE_API_RX_IPV4: need = 10; break;      // from, ports, protocol
+      case XBEE_API_CREATE_RESP:                    // ID, socket, status
+      case XBEE_API_CONNECT_RESP:
+      case XBEE_API_CLOSE_RESP:
+      case XBEE_API_SOCK_RECEIVE: need = 3; break;  // ID, socket, status
+      case XBEE_API_SOCK_STATUS: need = 2; break;   // socket, status
+      default: break;
+    }
+    if (len < need || !apiReadBytes(hdr, need)) { return 0; }
+    len -= need;
+
+    GsmClientXBee* sock = NULL;
+    String         text;
+    if (type == XBEE_API_AT_RESP) {
+      if (!apiReadValue(hdr, len, text)) { return 0; }
+      len = 0;
+    } else if (type == XBEE_API_SOCK_RECEIVE) {
+      sock = apiSocket(hdr[1]);
+    } else if (type == XBEE_API_RX_IPV4) {
+      IPAddress from(hdr[0], hdr[1], hdr[2], hdr[3]);
+      sock = apiSocket(from, (hdr[6] << 8) | hdr[7]);
+    }
+
+    // The payload, a piece at a time
+    uint8_t buf[64];
+    while (len) {
+      size_t n = TinyGsmMin(static_cast<size_t>(len), sizeof(buf));
+      if (!apiReadBytes(buf, n)) { return 0; }
+      if (sock) { apiDeliver(sock, buf, n); }
+      len -= n;
+    }
+
+    if (apiRead() < 0 || apiSum != 0xFF) {
+      DBG("### Bad API frame:", type);
+      return 0;
+    }
+
+    // Only an intact frame answers a request
+    switch (type) {
+      case XBEE_API_AT_RESP:
+        if (hdr[0] == apiAtId) { apiResponse = text; }
+        break;
+      case XBEE_API_TX_STATUS:
+        apiLastId     = hdr[0];
+        apiLastStatus = hdr[1];
+        break;
+      case XBEE_API_CREATE_RESP:
+      case XBEE_API_CONNECT_RESP:
+      case XBEE_API_CLOSE_RESP:
+        apiLastId     = hdr[0];
+        apiLastSock   = hdr[1];
+        apiLastStatus = hdr[2];
+        break;
+      case XBEE_API_SOCK_STATUS: apiSocketStatus(hdr[0], hdr[1]); break;
+      default: break;
+    }
+    return type;
+  }
+
+  // Reads frames until the one of the type answering the frame ID comes, or
+  // the time-out passes
+  bool apiWaitFrame(uint8_t type, uint8_t frameId, uint32_t timeout_ms) {
+    uint32_t startMillis = millis();
+    do {
+      if (!stream.available()) {
+        TINY_GSM_YIELD();
+        continue;
+      }
+      if (apiPoll() == type && apiLastId == frameId) { return true; }
+    } while (millis() - startMillis < timeout_ms);
+    return false;
+  }
+
+  // Reads the value in an AT command response, giving it as command mode
+  // would have: as text, as an IP address or as a number in hex
+  bool apiReadValue(const uint8_t* hdr, uint16_t len, String& text) {
+    char    cmd[3] = {static_cast<char>(hdr[1]), static_cast<char>(hdr[2]), 0};
+    uint8_t reg    = apiRegister(cmd);
+    text.reserve(2 * len + 1);
+    for (uint16_t i = 0; i < len; i++) {
+      int c = apiRead();
+      if (c < 0) { return false; }
+      if (reg == 2 && len == 4) {
+        if (i) { text += '.'; }
+        text += c;
+      } else if (reg) {
+        text += static_cast<char>(c);
+      } else {
+        text += "0123456789ABCDEF"[c >> 4];
+        text += "0123456789ABCDEF"[c & 0xF];
+      }
+    }
+    if (!reg) {
+      while (text.length() > 1 && text[0] == '0') { text.remove(0, 1); }
+    }
+    if (hdr[3]) {
+      text = "ERROR";
+    } else if (!len && !(reg && apiAtQuery)) {
+      text = "OK";
+    }
+    text += GSM_NL;
+    return true;
+  }
+
+  GsmClientXBee* apiSocket(uint8_t id) {
+    for (uint8_t mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      if (sockets[mux] && sockets[mux]->sock_id == id) { return sockets[mux]; }
+    }
+    return NULL;
+  }
+
+  GsmClientXBee* apiSocket(IPAddress ip, uint16_t port) {
+    for (uint8_t mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+      GsmClientXBee* sock = sockets[mux];
+      if (sock && sock->sock_port == port && sock->sock_ip == ip) {
+        return sock;
+      }
+    }
+    return NULL;
+  }
+
+  // A socket has connected, or failed to, or closed
+  void apiSocketStatus(uint8_t id, uint8_t status) {
+    GsmClientXBee* sock = apiSocket(id);
+    if (!sock) { return; }
+    if (sock->sock_connecting) {
+      connectFinished(sock->mux, status == 0x00);
+    } else if (status != 0x00) {
+      DBG("### Closed:", sock->mux, status);
+      sock->sock_connected = false;
+    }
+  }
+
+  // Hands payload to read() or readTo() if they are waiting for it, and to
+  // the socket's FIFO otherwise
+  void apiDeliver(GsmClientXBee* sock, const uint8_t* p, size_t n) {
+    if (sock->direct_size && sock->direct_sink) {
+      size_t k = TinyGsmMin(n, sock->direct_size);
+      sock->writeToSink(p, k);
+      p += k;
+      n -= k;
+    } else if (sock->direct_size && sock->direct_buf) {
+      size_t k = TinyGsmMin(n, sock->direct_size);
+      memcpy(sock->direct_buf, p, k);
+      sock->direct_buf += k;
+      sock->direct_size -= k;
+      p += k;
+      n -= k;
+    }
+    if (n) { sock->rx.put(p, n); }
+  }
+#endif
+
  public:
   Stream& stream;
 
@@ -1557,6 +2192,19 @@ class TinyGsmXBee : public TinyGsmModem<TinyGsmXBee>,
   IPAddress      savedOperatingIP;
   bool           inCommandMode;
   uint32_t       lastCommandModeMillis;
+  bool           inConfig;       // Between beginConfig() and commitConfig()
+  bool           configChanged;  // and with changes to write at the end
+  bool           apiMode;        // Set once the XBee talks in API frames
+#if defined(TINY_GSM_XBEE_API_MODE)
+  uint8_t apiFrameId    = 0;      // The last frame ID used
+  uint8_t apiSum        = 0;      // The checksum so far
+  uint8_t apiAtId       = 0;      // The frame ID of the last AT command,
+  bool    apiAtQuery    = false;  // whether it asked for a value,
+  String  apiResponse;            // and its answer, as command mode gives it
+  uint8_t apiLastId     = 0;      // What the last response frame said
+  uint8_t apiLastSock   = 0;
+  uint8_t apiLastStatus = 0;
+#endif
 };
 
 #endif  // SRC_TINYGSMCLIENTXBEE_H_
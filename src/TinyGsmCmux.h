@@ -0,0 +1,440 @@
+/**
+ * @file       TinyGsmCmux.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMCMUX_H_
+#define SRC_TINYGSMCMUX_H_
+
+#include "TinyGsmCommon.h"
+#include "TinyGsmFifo.h"
+
+// Virtual channels opened besides the multiplexer's own control channel
+#if !defined(TINY_GSM_CMUX_CHANNELS)
+#define TINY_GSM_CMUX_CHANNELS 2
+#endif
+
+#if TINY_GSM_CMUX_CHANNELS > 15
+#error TINY_GSM_CMUX_CHANNELS can be at most 15
+#endif
+
+// Receive buffer of each channel.  Once it has no room for another frame, the
+// modem is asked to hold that channel's data (with the FC bit of an MSC) until
+// it has been read; a frame that comes anyway and does not fit is dropped.
+#if !defined(TINY_GSM_CMUX_BUFFER)
+#define TINY_GSM_CMUX_BUFFER 256
+#endif
+
+// The largest frame taken in; longer ones are dropped
+#if !defined(TINY_GSM_CMUX_FRAME)
+#define TINY_GSM_CMUX_FRAME 127
+#endif
+
+// The largest frame sent.  27.010 has every module take at least 31.
+#if !defined(TINY_GSM_CMUX_TX_FRAME)
+#define TINY_GSM_CMUX_TX_FRAME 31
+#endif
+
+// A 3GPP 27.010 multiplexer in basic mode over the modem's serial port,
+// presenting channels 1 to TINY_GSM_CMUX_CHANNELS as Streams of their own.
+// Each can carry a modem object, so that (for instance) the sockets on one
+// and signal quality or registration checks on another never wait on each
+// other's responses, or one channel can be left to the GNSS NMEA output.
+//
+// Frames are taken in by whichever channel is read, and sorted into the
+// channels' buffers; the channels are not safe to use from several tasks
+// at once without a lock around them.
+//
+//   TinyGsmCmux cmux(SerialAT);
+//   cmux.begin();
+//   TinyGsm     modem(cmux.channel(1));
+//   TinyGsm     control(cmux.channel(2));
+class TinyGsmCmux {
+ public:
+  /*
+   * Virtual channel
+   */
+  class Channel : public Stream {
+    friend class TinyGsmCmux;
+
+   public:
+    int available() override {
+      sendPending();
+      if (!rx.size()) { cmux->resume(dlci); }
+      cmux->poll();
+      return rx.size();
+    }
+
+    int read() override {
+      uint8_t c;
+      if (!rx.size()) { available(); }
+      if (rx.get(&c)) { return c; }
+      return -1;
+    }
+
+    int peek() override {
+      if (!rx.size()) { available(); }
+      if (!rx.size()) { return -1; }
+      return rx.peek();
+    }
+
+    // Characters are gathered into frames of up to TINY_GSM_CMUX_TX_FRAME,
+    // sent when full, on flush() or once the channel is read
+    size_t write(uint8_t c) override {
+      tx[tx_len++] = c;
+      if (tx_len == sizeof(tx)) { sendPending(); }
+      return 1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+      for (size_t i = 0; i < size; i++) { write(buf[i]); }
+      return size;
+    }
+
+    void flush() override {
+      sendPending();
+      cmux->stream.flush();
+    }
+
+    // Room left in the frame being gathered, or 0 while the other end has
+    // asked (with the FC bit of an MSC) for nothing more to be sent on the
+    // channel.  write() itself does not wait.
+    int availableForWrite() override {
+      if (cmux->held & (1U << dlci)) { return 0; }
+      return sizeof(tx) - tx_len;
+    }
+
+    using Print::write;
+
+    bool isOpen() const {
+      return cmux->isOpen(dlci);
+    }
+
+   protected:
+    void sendPending() {
+      if (!tx_len) { return; }
+      cmux->sendFrame(dlci, UIH, tx, tx_len);
+      tx_len = 0;
+    }
+
+    TinyGsmCmux*                               cmux   = NULL;
+    uint8_t                                    dlci   = 0;
+    uint8_t                                    tx_len = 0;
+    uint8_t                                    tx[TINY_GSM_CMUX_TX_FRAME];
+    TinyGsmFifo<uint8_t, TINY_GSM_CMUX_BUFFER> rx;
+  };
+
+  /*
+   * Multiplexer
+   */
+ public:
+  explicit TinyGsmCmux(Stream& stream) : stream(stream) {
+    for (uint8_t i = 0; i < TINY_GSM_CMUX_CHANNELS; i++) {
+      channels[i].cmux = this;
+      channels[i].dlci = i + 1;
+    }
+  }
+
+  // Puts the modem into multiplexer mode and opens the control channel and
+  // each virtual channel.  The modem must be answering AT commands.
+  bool begin(uint32_t timeout_ms = 3000L) {
+    stream.print(GF("AT+CMUX=0\r\n"));
+    stream.flush();
+    if (!waitOk(timeout_ms)) { return false; }
+    if (!open(0, timeout_ms)) { return false; }
+    for (uint8_t i = 1; i <= TINY_GSM_CMUX_CHANNELS; i++) {
+      if (!open(i, timeout_ms)) { return false; }
+    }
+    return true;
+  }
+
+  // Closes the multiplexer down, leaving the modem in plain AT mode
+  void end() {
+    for (uint8_t i = 0; i < TINY_GSM_CMUX_CHANNELS; i++) {
+      channels[i].sendPending();
+    }
+    static const uint8_t cld[] = {0xC3, 0x01};
+    sendFrame(0, UIH, cld, sizeof(cld));
+    stream.flush();
+    opened = 0;
+  }
+
+  // Opens a channel (DLCI) with SABM and waits for the modem's UA.  Opening
+  // a virtual channel also sets its V.24 signals ready with an MSC, which
+  // some modules wait for before they send anything on it.
+  bool open(uint8_t dlci, uint32_t timeout_ms = 3000L) {
+    refused &= ~(1U << dlci);
+    sendFrame(dlci, SABM | PF, NULL, 0, true);
+    uint32_t startMillis = millis();
+    while (!isOpen(dlci)) {
+      if (refused & (1U << dlci) || millis() - startMillis >= timeout_ms) {
+        DBG("### CMUX channel", dlci, "not opened");
+        return false;
+      }
+      poll();
+      TINY_GSM_YIELD();
+    }
+    if (dlci) {
+      stopped &= ~(1U << dlci);
+      sendSignals(dlci);
+    }
+    return true;
+  }
+
+  bool isOpen(uint8_t dlci) const {
+    return opened & (1U << dlci);
+  }
+
+  // Virtual channel 1 to TINY_GSM_CMUX_CHANNELS
+  Channel& channel(uint8_t dlci) {
+    if (dlci < 1 || dlci > TINY_GSM_CMUX_CHANNELS) { dlci = 1; }
+    return channels[dlci - 1];
+  }
+
+  // Frames dropped, as damaged, too long or with no room in their channel
+  uint16_t errors() const {
+    return dropped;
+  }
+
+  // Takes in whatever the port holds, sorting it into the channels
+  void poll() {
+    while (stream.available()) {
+      int c = stream.read();
+      if (c < 0) { break; }
+      take(c);
+    }
+  }
+
+  /*
+   * Framing
+   */
+ protected:
+  static const uint8_t FLAG    = 0xF9;
+  static const uint8_t SABM    = 0x2F;
+  static const uint8_t UA      = 0x63;
+  static const uint8_t DM      = 0x0F;
+  static const uint8_t DISC    = 0x43;
+  static const uint8_t UIH     = 0xEF;
+  static const uint8_t UI      = 0x03;
+  static const uint8_t PF      = 0x10;
+  static const uint8_t MSC_CMD = 0xE3;
+  static const uint8_t MSC_RSP = 0xE1;
+
+  enum State {
+    S_FLAG,
+    S_ADDR,
+    S_CTRL,
+    S_LEN1,
+    S_LEN2,
+    S_DATA,
+    S_FCS,
+    S_SKIP
+  };
+
+  // CRC-8 of 27.010 (reversed polynomial 0xE0), started at 0xFF
+  static uint8_t crc(uint8_t crc, uint8_t c) {
+    crc ^= c;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+    }
+    return crc;
+  }
+
+  // Commands and data go out with C/R set, responses with it clear.  The
+  // check sequence covers the header, and the data too except for UIH.
+  void sendFrame(uint8_t dlci, uint8_t ctrl, const uint8_t* data, size_t len,
+                 bool command = true) {
+    uint8_t head[4];
+    uint8_t n = 0;
+    head[n++] = dlci << 2 | (command ? 0x02 : 0x00) | 0x01;
+    head[n++] = ctrl;
+    if (len < 128) {
+      head[n++] = len << 1 | 0x01;
+    } else {
+      head[n++] = len << 1;
+      head[n++] = len >> 7;
+    }
+    uint8_t fcs = 0xFF;
+    for (uint8_t i = 0; i < n; i++) { fcs = crc(fcs, head[i]); }
+    if ((ctrl & ~PF) != UIH) {
+      for (size_t i = 0; i < len; i++) { fcs = crc(fcs, data[i]); }
+    }
+    stream.write(FLAG);
+    stream.write(head, n);
+    if (len) { stream.write(data, len); }
+    stream.write(static_cast<uint8_t>(0xFF - fcs));
+    stream.write(FLAG);
+  }
+
+  void take(uint8_t c) {
+    switch (state) {
+      case S_FLAG:
+        if (c == FLAG) { state = S_ADDR; }
+        return;
+      case S_ADDR:
+        // Flags may be repeated between frames
+        if (c == FLAG) { return; }
+        addr  = c;
+        fcs   = crc(0xFF, c);
+        state = S_CTRL;
+        return;
+      case S_CTRL:
+        ctrl  = c;
+        fcs   = crc(fcs, c);
+        state = S_LEN1;
+        return;
+      case S_LEN1:
+      case S_LEN2:
+        fcs = crc(fcs, c);
+        if (state == S_LEN1) {
+          len = c >> 1;
+        } else {
+          len |= static_cast<uint16_t>(c) << 7;
+        }
+        got = 0;
+        if (state == S_LEN1 && !(c & 0x01)) {
+          state = S_LEN2;
+        } else if (len > sizeof(frame)) {
+          // Passed over as a whole, as the data can hold flags
+          dropped++;
+          state = S_SKIP;
+        } else {
+          state = len ? S_DATA : S_FCS;
+        }
+        return;
+      case S_DATA:
+        frame[got++] = c;
+        if ((ctrl & ~PF) != UIH) { fcs = crc(fcs, c); }
+        if (got == len) { state = S_FCS; }
+        return;
+      case S_FCS:
+        state = S_FLAG;
+        if (crc(fcs, c) != 0xCF) {
+          dropped++;
+          return;
+        }
+        handleFrame();
+        return;
+      case S_SKIP:
+        // The data and the check sequence
+        if (++got > len) { state = S_FLAG; }
+        return;
+    }
+  }
+
+  void handleFrame() {
+    uint8_t dlci = addr >> 2;
+    if (dlci > TINY_GSM_CMUX_CHANNELS) { return; }
+    switch (ctrl & ~PF) {
+      case UA: opened |= 1U << dlci; break;
+      case DM:
+        opened &= ~(1U << dlci);
+        refused |= 1U << dlci;
+        break;
+      case SABM:
+        opened |= 1U << dlci;
+        sendFrame(dlci, UA | PF, NULL, 0, false);
+        break;
+      case DISC:
+        opened &= ~(1U << dlci);
+        sendFrame(dlci, UA | PF, NULL, 0, false);
+        break;
+      case UIH:
+      case UI:
+        if (dlci == 0) {
+          handleControl();
+        } else {
+          deliver();
+        }
+        break;
+    }
+  }
+
+  // Hands the data frame taken in to its channel.  A channel left unread
+  // must not keep the others waiting, so once it cannot take another frame
+  // the modem is told to stop sending on it, and what still comes is dropped.
+  void deliver() {
+    uint8_t  dlci = addr >> 2;
+    Channel& ch   = channels[dlci - 1];
+    if (ch.rx.free() < static_cast<int>(len)) {
+      dropped++;
+    } else {
+      ch.rx.put(frame, len);
+    }
+    if (ch.rx.free() < static_cast<int>(sizeof(frame)) &&
+        !(stopped & (1U << dlci))) {
+      stopped |= 1U << dlci;
+      sendSignals(dlci);
+    }
+  }
+
+  // Lets the modem send on a channel stopped by deliver() again
+  void resume(uint8_t dlci) {
+    if (!(stopped & (1U << dlci))) { return; }
+    stopped &= ~(1U << dlci);
+    sendSignals(dlci);
+  }
+
+  // An MSC with the channel's V.24 signals: ready to send and to receive,
+  // and data valid, with flow control (FC) set while it is stopped
+  void sendSignals(uint8_t dlci) {
+    uint8_t       signals = (stopped & (1U << dlci)) ? 0x8F : 0x8D;
+    const uint8_t msc[]   = {MSC_CMD, 0x05,
+                             static_cast<uint8_t>(dlci << 2 | 0x03), signals};
+    sendFrame(0, UIH, msc, sizeof(msc));
+  }
+
+  // Messages on the control channel.  The modem's MSC's are acknowledged,
+  // noting whether it wants a channel held back, and the rest (ie, the
+  // responses to our own) needs no action.
+  void handleControl() {
+    if (len < 2 || frame[0] != MSC_CMD) { return; }
+    if (len >= 4) {
+      uint16_t bit = 1U << (frame[2] >> 2);
+      held         = (frame[3] & 0x02) ? held | bit : held & ~bit;
+    }
+    frame[0] = MSC_RSP;
+    sendFrame(0, UIH, frame, len);
+  }
+
+  // Waits for the OK to AT+CMUX, before the port switches over to frames
+  bool waitOk(uint32_t timeout_ms) {
+    uint8_t  seen        = 0;
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < timeout_ms) {
+      int c = stream.read();
+      if (c < 0) {
+        TINY_GSM_YIELD();
+        continue;
+      }
+      if (c == "OK\r\n"[seen]) {
+        if (++seen == 4) { return true; }
+      } else {
+        seen = (c == 'O') ? 1 : 0;
+      }
+    }
+    return false;
+  }
+
+  Stream&  stream;
+  Channel  channels[TINY_GSM_CMUX_CHANNELS];
+  uint16_t opened  = 0;
+  uint16_t refused = 0;
+  uint16_t stopped = 0;  // Channels the modem was told to stop sending on
+  uint16_t held    = 0;  // Channels the modem told us to stop sending on
+  uint16_t dropped = 0;
+
+  // The frame being taken in
+  State    state = S_FLAG;
+  uint8_t  addr  = 0;
+  uint8_t  ctrl  = 0;
+  uint8_t  fcs   = 0;
+  uint16_t len   = 0;
+  uint16_t got   = 0;
+  uint8_t  frame[TINY_GSM_CMUX_FRAME];
+};
+
+#endif  // SRC_TINYGSMCMUX_H_
@@ -46,11 +46,13 @@
 typedef const __FlashStringHelper* GsmConstStr;
 #define GFP(x) (reinterpret_cast<GsmConstStr>(x))
 #define GF(x) F(x)
+#define TINY_GSM_PGM_BYTE(p) pgm_read_byte(p)
 #else
 #define TINY_GSM_PROGMEM
 typedef const char* GsmConstStr;
 #define GFP(x) x
 #define GF(x) x
+#define TINY_GSM_PGM_BYTE(p) (*(p))
 #endif
 
 #ifdef TINY_GSM_DEBUG
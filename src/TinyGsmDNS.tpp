@@ -0,0 +1,255 @@
+/**
+ * @file       TinyGsmDNS.tpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMDNS_H_
+#define SRC_TINYGSMDNS_H_
+
+#include "TinyGsmCommon.h"
+
+#define TINY_GSM_MODEM_HAS_DNS
+
+// How many host names are remembered; the least recently used one makes room
+#if !defined(TINY_GSM_DNS_CACHE)
+#define TINY_GSM_DNS_CACHE 4
+#endif
+
+// How long a looked up address is trusted for, in seconds
+#if !defined(TINY_GSM_DNS_TTL)
+#define TINY_GSM_DNS_TTL 300
+#endif
+
+// How long the modem is given to look up a host, in ms
+#if !defined(TINY_GSM_DNS_TIMEOUT)
+#define TINY_GSM_DNS_TIMEOUT 30000L
+#endif
+
+template <class modemType>
+class TinyGsmDNS {
+ public:
+  /*
+   * DNS functions
+   */
+  // The host's address, from the cache if it was looked up in the last
+  // TINY_GSM_DNS_TTL seconds, otherwise from the modem.  Gives 0.0.0.0 if the
+  // lookup fails, or with a timeout of 0 if the host is not cached.
+  // connect() goes through the same cache.
+  IPAddress resolve(const char* host,
+                    uint32_t    timeout_ms = TINY_GSM_DNS_TIMEOUT) {
+    uint8_t ip[4];
+    if (!dnsResolve(host, ip, timeout_ms)) { return IPAddress(0, 0, 0, 0); }
+    return IPAddress(ip[0], ip[1], ip[2], ip[3]);
+  }
+
+  // Looks up a list of hosts ahead of time (ie, at boot, once the network is
+  // up), so that the first connect() to each of them finds its address
+  // cached.  Returns how many were found.
+  uint8_t prefetch(const char* const hosts[], uint8_t count,
+                   uint32_t timeout_ms = TINY_GSM_DNS_TIMEOUT) {
+    uint8_t found = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      if (resolve(hosts[i], timeout_ms) != IPAddress(0, 0, 0, 0)) { found++; }
+    }
+    return found;
+  }
+
+  // Forgets the cached address of a host, or of every host
+  void clearDnsCache(const char* host = NULL) {
+    TinyGsmDnsKey key = dnsKey(host ? host : "");
+    for (uint8_t i = 0; i < TINY_GSM_DNS_CACHE; i++) {
+      TinyGsmDnsEntry& e = dnsCache[i];
+      if (!host || dnsSame(e.key, key)) { e.key.hash = 0; }
+    }
+  }
+
+  /*
+   * CRTP Helper
+   */
+ protected:
+  inline const modemType& thisModem() const {
+    return static_cast<const modemType&>(*this);
+  }
+  inline modemType& thisModem() {
+    return static_cast<modemType&>(*this);
+  }
+
+  /*
+   * DNS functions
+   */
+ protected:
+  // What modemConnect() hands the modem for host: its address, if it is
+  // cached or can be looked up, so that reconnecting costs no lookup on the
+  // network; otherwise the name itself, for the modem to try.  The lookup
+  // comes out of the connect's own timeout, which is left with what remains.
+  // With async set only the cache is tried, so that connectAsync() never
+  // waits on the network.
+  String dnsConnectHost(const char* host, uint32_t& timeout_ms,
+                        bool async = false) {
+    if (dnsIsAddress(host)) { return host; }
+    uint8_t  ip[4];
+    uint32_t start = millis();
+    bool     found = dnsResolve(host, ip, async ? 0 : timeout_ms);
+    uint32_t spent = millis() - start;
+    timeout_ms     = spent < timeout_ms ? timeout_ms - spent : 0;
+    if (!found) { return host; }
+    String res;
+    res.reserve(16);
+    for (uint8_t i = 0; i < 4; i++) {
+      if (i) { res += '.'; }
+      res += ip[i];
+    }
+    return res;
+  }
+
+  // For modemConnect() with async set, once the modem has answered the
+  // command: notes which cached address the mux went to, so that
+  // dnsConnectFinished() can forget it if the connection then fails, as a
+  // failed connect() does.  Gives back taken.
+  bool dnsConnectStarted(const char* host, uint8_t mux, bool taken) {
+    TinyGsmDnsKey key = dnsKey(host);
+    for (uint8_t i = 0; i < TINY_GSM_DNS_CACHE; i++) {
+      TinyGsmDnsEntry& e = dnsCache[i];
+      e.waiting &= ~(1UL << mux);
+      if (taken && e.key.hash && dnsSame(e.key, key)) {
+        e.waiting |= 1UL << mux;
+      }
+    }
+    if (!taken) { clearDnsCache(host); }
+    return taken;
+  }
+
+  // For the URC handlers, next to connectFinished(): forgets the address a
+  // connectAsync() on the mux went to if it could not connect there
+  void dnsConnectFinished(int mux, bool ok) {
+    if (mux < 0 || mux >= 32) { return; }
+    for (uint8_t i = 0; i < TINY_GSM_DNS_CACHE; i++) {
+      TinyGsmDnsEntry& e = dnsCache[i];
+      if (!(e.waiting & (1UL << mux))) { continue; }
+      e.waiting &= ~(1UL << mux);
+      if (!ok) { e.key.hash = 0; }
+    }
+  }
+
+  bool dnsResolve(const char* host, uint8_t ip[4], uint32_t timeout_ms) {
+    if (!host || !*host) { return false; }
+    TinyGsmDnsKey    key   = dnsKey(host);
+    TinyGsmDnsEntry* entry = dnsFind(key);
+    if (entry) {
+      DBG("### DNS cached:", host);
+      entry->used = ++dnsUses;
+      memcpy(ip, entry->ip, 4);
+      return true;
+    }
+    if (!timeout_ms) { return false; }
+
+    IPAddress addr = modemType::TinyGsmIpFromString(
+        thisModem().dnsLookupImpl(host, timeout_ms));
+    if (addr == IPAddress(0, 0, 0, 0)) { return false; }
+
+    entry = dnsVictim();
+    for (uint8_t i = 0; i < 4; i++) { entry->ip[i] = ip[i] = addr[i]; }
+    entry->key     = key;
+    entry->stored  = millis();
+    entry->used    = ++dnsUses;
+    entry->waiting = 0;
+    return true;
+  }
+
+  // Looks up a host with +CDNSGIP, as the SIMCom modems do, giving its
+  // (first) address as text, or an empty string if it was not found.  The
+  // answer comes as a URC once the command's OK is out of the way.
+  String dnsLookupImpl(const char* host, uint32_t timeout_ms) {
+    thisModem().sendAT(GF("+CDNSGIP=\""), host, '"');
+    if (thisModem().waitResponse() != 1) { return ""; }
+    // +CDNSGIP: 1,"<domain>","<IP>"[,"<IP2>"] or +CDNSGIP: 0,<error>
+    if (thisModem().waitResponse(timeout_ms, GF("+CDNSGIP:")) != 1) {
+      return "";
+    }
+    if (thisModem().streamGetIntBefore(',') != 1) {
+      thisModem().streamSkipUntil('\n');
+      return "";
+    }
+    thisModem().streamSkipUntil(',');  // Skip the domain
+    thisModem().streamSkipUntil('"');
+    String res = thisModem().stream.readStringUntil('"');
+    thisModem().streamSkipUntil('\n');
+    return res;
+  }
+
+  // Stands in for the host name, which is not kept: two different hashes of
+  // it and its length must all match for an entry to be taken as the name's
+  struct TinyGsmDnsKey {
+    uint32_t hash;   // FNV-1a; never 0, which marks a free entry
+    uint32_t check;  // djb2
+    uint16_t len;
+  };
+
+  struct TinyGsmDnsEntry {
+    TinyGsmDnsKey key;
+    uint32_t      stored;   // When it was looked up
+    uint32_t      used;     // The dnsUses count when it was last handed out
+    uint32_t      waiting;  // Muxes with a connectAsync() to it under way
+    uint8_t       ip[4];
+  };
+
+  TinyGsmDnsEntry* dnsFind(const TinyGsmDnsKey& key) {
+    for (uint8_t i = 0; i < TINY_GSM_DNS_CACHE; i++) {
+      TinyGsmDnsEntry& e = dnsCache[i];
+      if (!e.key.hash || !dnsSame(e.key, key)) { continue; }
+      if (millis() - e.stored < TINY_GSM_DNS_TTL * 1000UL) { return &e; }
+      e.key.hash = 0;  // Expired
+    }
+    return NULL;
+  }
+
+  // A free entry if there is one, otherwise the least recently used
+  TinyGsmDnsEntry* dnsVictim() {
+    TinyGsmDnsEntry* victim = &dnsCache[0];
+    for (uint8_t i = 0; i < TINY_GSM_DNS_CACHE; i++) {
+      TinyGsmDnsEntry& e = dnsCache[i];
+      if (!e.key.hash) { return &e; }
+      if (dnsUses - e.used > dnsUses - victim->used) { victim = &e; }
+    }
+    return victim;
+  }
+
+  // The key of the name, which is not case sensitive
+  static TinyGsmDnsKey dnsKey(const char* host) {
+    TinyGsmDnsKey key = {2166136261UL, 5381UL, 0};
+    for (; *host; host++) {
+      char c = *host;
+      if (c >= 'A' && c <= 'Z') { c += 'a' - 'A'; }
+      key.hash  = (key.hash ^ static_cast<uint8_t>(c)) * 16777619UL;
+      key.check = key.check * 33 + static_cast<uint8_t>(c);
+      key.len++;
+    }
+    if (!key.hash) { key.hash = 1; }
+    return key;
+  }
+
+  static bool dnsSame(const TinyGsmDnsKey& a, const TinyGsmDnsKey& b) {
+    return a.hash == b.hash && a.check == b.check && a.len == b.len;
+  }
+
+  // Whether the host is already a dotted address, which needs no lookup
+  static bool dnsIsAddress(const char* host) {
+    uint8_t dots = 0;
+    for (; *host; host++) {
+      if (*host == '.') {
+        dots++;
+      } else if (*host < '0' || *host > '9') {
+        return false;
+      }
+    }
+    return dots == 3;
+  }
+
+  TinyGsmDnsEntry dnsCache[TINY_GSM_DNS_CACHE] = {};
+  uint32_t        dnsUses                      = 0;
+};
+
+#endif  // SRC_TINYGSMDNS_H_
@@ -1,10 +1,25 @@
 #ifndef TinyGsmFifo_h
 #define TinyGsmFifo_h
 
+// With TINY_GSM_FIFO_ATOMIC defined the indexes are std::atomic, published
+// with release and read with acquire ordering, so one writer and one reader
+// (ie, a UART interrupt and the main loop, or two RTOS tasks / cores) can use
+// the same FIFO without a lock.  clear() still needs both sides to be idle.
+#if defined(TINY_GSM_FIFO_ATOMIC)
+#include <atomic>
+#endif
+
 template <class T, unsigned N>
 class TinyGsmFifo
 {
 public:
+    // A contiguous run of elements inside the FIFO
+    struct Span
+    {
+        T*     data;
+        size_t size;
+    };
+
     TinyGsmFifo()
     {
         clear();
@@ -12,8 +27,8 @@ public:
 
     void clear()
     {
-        _r = 0;
-        _w = 0;
+        _release(_r, 0);
+        _release(_w, 0);
     }
 
     // writing thread/context API
@@ -26,21 +41,18 @@ public:
 
     int free(void)
     {
-        int s = _r - _w;
-        if (s <= 0)
-            s += N;
-        return s - 1;
+        return N - 1 - size();
     }
 
     bool put(const T& c)
     {
-        int i = _w;
-        int j = i;
+        unsigned i = _relaxed(_w);
+        unsigned j = i;
         i = _inc(i);
-        if (i == _r) // !writeable()
+        if (i == _acquire(_r)) // !writeable()
             return false;
         _b[j] = c;
-        _w = i;
+        _release(_w, i);
         return true;
     }
 
@@ -57,41 +69,61 @@ public:
             }
             // check free space
             if (c < f) f = c;
-            int w = _w;
+            unsigned w = _relaxed(_w);
             int m = N - w;
             // check wrap
             if (f > m) f = m;
-            memcpy(&_b[w], p, f);
-            _w = _inc(w, f);
+            memcpy(&_b[w], p, f * sizeof(T));
+            _release(_w, _inc(w, f));
             c -= f;
             p += f;
         }
         return n - c;
     }
 
+    // The free space that can be written in one go, up to the end of the
+    // buffer.  Write into it directly, then commit() what was written.
+    Span writableSpan(void)
+    {
+        unsigned r = _acquire(_r);
+        unsigned w = _relaxed(_w);
+        Span s;
+        s.data = &_b[w];
+        if (w < r)
+            s.size = r - w - 1;
+        else
+            s.size = N - w - (r == 0 ? 1 : 0);
+        return s;
+    }
+
+    void commit(size_t n)
+    {
+        _release(_w, _inc(_relaxed(_w), n));
+    }
+
     // reading thread/context API
     // --------------------------------------------------------
 
     bool readable(void)
     {
-        return (_r != _w);
+        return (_acquire(_r) != _acquire(_w));
     }
 
+    // Safe from either side: by the time it returns the other side can only
+    // have freed more space (for the writer) or added more data (for the
+    // reader)
     size_t size(void)
     {
-        int s = _w - _r;
-        if (s < 0)
-            s += N;
-        return s;
+        return _wrap(_acquire(_w) + N - _acquire(_r));
     }
 
     bool get(T* p)
     {
-        int r = _r;
-        if (r == _w) // !readable()
+        unsigned r = _relaxed(_r);
+        if (r == _acquire(_w)) // !readable()
             return false;
         *p = _b[r];
-        _r = _inc(r);
+        _release(_r, _inc(r));
         return true;
     }
 
@@ -110,32 +142,97 @@ public:
             }
             // check available data
             if (c < f) f = c;
-            int r = _r;
+            unsigned r = _relaxed(_r);
             int m = N - r;
             // check wrap
             if (f > m) f = m;
-            memcpy(p, &_b[r], f);
-            _r = _inc(r, f);
+            memcpy(p, &_b[r], f * sizeof(T));
+            _release(_r, _inc(r, f));
             c -= f;
             p += f;
         }
         return n - c;
     }
 
+    // The data that can be read in one go, up to the end of the buffer.
+    // Read it in place, then consume() what was used.
+    Span readableSpan(void)
+    {
+        unsigned r = _relaxed(_r);
+        unsigned w = _acquire(_w);
+        Span s;
+        s.data = &_b[r];
+        s.size = (w >= r) ? w - r : N - r;
+        return s;
+    }
+
+    void consume(size_t n)
+    {
+        _release(_r, _inc(_relaxed(_r), n));
+    }
+
 	uint8_t peek()
 	{
-		return _b[_r];
+		return _b[_relaxed(_r)];
 	}
 
 private:
-    int _inc(int i, int n = 1)
+    // Indexes never run more than N past the end, so no division is needed;
+    // a power-of-two N needs only a mask
+    static unsigned _wrap(unsigned i)
+    {
+        if ((N & (N - 1)) == 0)
+            return i & (N - 1);
+        return (i >= N) ? i - N : i;
+    }
+
+    static unsigned _inc(unsigned i, unsigned n = 1)
+    {
+        return _wrap(i + n);
+    }
+
+#if defined(TINY_GSM_FIFO_ATOMIC)
+    typedef std::atomic<unsigned> Index;
+
+    // The other side's index: everything it published before is visible
+    static unsigned _acquire(const Index& i)
+    {
+        return i.load(std::memory_order_acquire);
+    }
+
+    // Our own index, which only we change
+    static unsigned _relaxed(const Index& i)
+    {
+        return i.load(std::memory_order_relaxed);
+    }
+
+    // Publishes our index after the elements it covers
+    static void _release(Index& i, unsigned v)
     {
-        return (i + n) % N;
+        i.store(v, std::memory_order_release);
     }
+#else
+    typedef unsigned Index;
+
+    static unsigned _acquire(const Index& i)
+    {
+        return i;
+    }
+
+    static unsigned _relaxed(const Index& i)
+    {
+        return i;
+    }
+
+    static void _release(Index& i, unsigned v)
+    {
+        i = v;
+    }
+#endif
 
-    T    _b[N];
-    int  _w;
-    int  _r;
+    T     _b[N];
+    Index _w;
+    Index _r;
 };
 
 #endif
@@ -0,0 +1,130 @@
+/**
+ * @file       TinyGsmMatcher.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMMATCHER_H_
+#define SRC_TINYGSMMATCHER_H_
+
+#include "TinyGsmCommon.h"
+
+#if !defined(TINY_GSM_MATCHER_SIZE)
+// Enough for the five (six on MC60) expected responses plus the longest list
+// of URC's any of the modems watches for
+#define TINY_GSM_MATCHER_SIZE 16
+#endif
+
+// Matches characters read from the modem against a fixed set of patterns
+// (expected responses and URC prefixes, which may live in PROGMEM) without
+// buffering what has been read.
+//
+// For each pattern only the length of the prefix matched so far is kept.
+// Every incoming character moves each of those one step, so the usual cost is
+// a single comparison per pattern.  After a partial match breaks, the longest
+// prefix that is still matched is worked out from the pattern itself (the KMP
+// failure function, without a table), so reporting a match is exactly
+// equivalent to "everything read so far endsWith(pattern)".
+template <uint8_t N>
+class TinyGsmMatcher {
+ public:
+  TinyGsmMatcher() : _count(0) {
+    clearLine();
+  }
+
+  // Adds a pattern and returns its 1-based index, or 0 if the matcher is full.
+  // NULL patterns never match, but still take a slot so that indexes line up
+  // with the caller's list.
+  uint8_t add(GsmConstStr pattern) {
+    if (_count >= N) { return 0; }
+    _pat[_count] = reinterpret_cast<const char*>(pattern);
+    _pos[_count] = 0;
+    return ++_count;
+  }
+
+  uint8_t count() const {
+    return _count;
+  }
+
+  // Drops all patterns
+  void clear() {
+    _count = 0;
+    clearLine();
+  }
+
+  // Forgets everything read so far
+  void reset() {
+    for (uint8_t i = 0; i < _count; i++) { _pos[i] = 0; }
+    clearLine();
+  }
+
+  // Feeds one character to all patterns.  Returns the 1-based index of the
+  // first pattern that the text now ends with, or 0 if none does.
+  uint8_t feed(char c) {
+    if (_newLine) { clearLine(); }
+    if (_lineLen < sizeof(_line) - 1) {
+      _line[_lineLen++] = c;
+      _line[_lineLen]   = '\0';
+    }
+    _newLine = (c == '\n');
+
+    uint8_t hit = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_pat[i] && step(i, c) && !hit) { hit = i + 1; }
+    }
+    return hit;
+  }
+
+  // The first few characters of the line being read, for URC's that carry
+  // information in front of the matched text (ie, the mux in "0, CLOSED")
+  const char* line() const {
+    return _line;
+  }
+
+ protected:
+  bool step(uint8_t i, char c) {
+    const char* p  = _pat[i];
+    uint8_t     k  = _pos[i];
+    char        pc = TINY_GSM_PGM_BYTE(p + k);
+    if (pc == c) {
+      _pos[i] = ++k;
+      return TINY_GSM_PGM_BYTE(p + k) == '\0';
+    }
+    // An empty pattern matches anything
+    if (k == 0) { return pc == '\0'; }
+    k       = fallback(p, k, c);
+    _pos[i] = k;
+    return k && TINY_GSM_PGM_BYTE(p + k) == '\0';
+  }
+
+  // Length of the longest prefix of p that is a suffix of p[0..k-1] + c
+  static uint8_t fallback(const char* p, uint8_t k, char c) {
+    for (uint8_t l = k; l > 0; l--) {
+      if (TINY_GSM_PGM_BYTE(p + l - 1) != c) { continue; }
+      uint8_t j = 0;
+      while (j < l - 1 &&
+             TINY_GSM_PGM_BYTE(p + j) == TINY_GSM_PGM_BYTE(p + k - l + 1 + j)) {
+        j++;
+      }
+      if (j == l - 1) { return l; }
+    }
+    return 0;
+  }
+
+  void clearLine() {
+    _line[0] = '\0';
+    _lineLen = 0;
+    _newLine = false;
+  }
+
+  const char* _pat[N];
+  uint8_t     _pos[N];
+  uint8_t     _count;
+  char        _line[8];
+  uint8_t     _lineLen;
+  bool        _newLine;
+};
+
+#endif  // SRC_TINYGSMMATCHER_H_
@@ -10,6 +10,17 @@
 #define SRC_TINYGSMMODEM_H_
 
 #include "TinyGsmCommon.h"
+#include "TinyGsmMatcher.h"
+
+// One entry of a modem's URC table: the text that starts the URC (in PROGMEM)
+// and the member function that reads out the rest of it.  Each modem keeps
+// its table as a constexpr array ending in {NULL, NULL}, returned by its
+// urcTable().
+template <class modemType>
+struct TinyGsmUrc {
+  const char* prefix;
+  bool (modemType::*handler)(const char* line, String* data);
+};
 
 template <class modemType>
 class TinyGsmModem {
@@ -269,6 +280,62 @@ class TinyGsmModem {
   }
 
  protected:
+  // Reads from the modem until one of the expected responses shows up or the
+  // time-out passes.  Any URC's in the modem's urcTable() are handed to their
+  // handlers along the way.  Each character is read only once and
+  // checked against every pattern in one pass of the matcher; the text itself
+  // is only collected if the caller wants it back in data.
+  // Returns the 1-based index of the response found, 0 on time-out.
+  int8_t waitResponseImpl(uint32_t timeout_ms, String* data,
+                          const GsmConstStr* responses, uint8_t count) {
+    TinyGsmMatcher<TINY_GSM_MATCHER_SIZE> matcher;
+    for (uint8_t i = 0; i < count; i++) { matcher.add(responses[i]); }
+    for (uint8_t i = 0; modemType::urcTable()[i].prefix != NULL; i++) {
+      matcher.add(GFP(modemType::urcTable()[i].prefix));
+    }
+
+    if (data) { data->reserve(64); }
+    uint8_t  index       = 0;
+    uint32_t startMillis = millis();
+    do {
+      TINY_GSM_YIELD();
+      while (thisModem().stream.available() > 0) {
+        TINY_GSM_YIELD();
+        int8_t a = thisModem().stream.read();
+        if (a <= 0) continue;  // Skip 0x00 bytes, just in case
+        if (data) { *data += static_cast<char>(a); }
+        uint8_t hit = matcher.feed(a);
+        if (!hit) { continue; }
+        if (hit <= count) {
+          index = hit;
+          goto finish;
+        }
+        // The handler says whether the text so far was used up by the URC
+        if (handleURC(modemType::urcTable()[hit - count - 1], matcher.line(),
+                      data)) {
+          matcher.reset();
+          if (data) { *data = ""; }
+        }
+      }
+    } while (millis() - startMillis < timeout_ms);
+  finish:
+    if (!index && data) {
+      data->trim();
+      if (data->length()) { DBG("### Unhandled:", *data); }
+      *data = "";
+    }
+    // data.replace(GSM_NL, "/");
+    // DBG('<', index, '>', data);
+    return index;
+  }
+
+  // The table may belong to a class derived from modemType (ie, the SIM70xx
+  // family), so the handler is called on that
+  template <class T>
+  bool handleURC(const TinyGsmUrc<T>& urc, const char* line, String* data) {
+    return (static_cast<T&>(thisModem()).*urc.handler)(line, data);
+  }
+
   inline bool streamGetLength(char* buf, int8_t numChars,
                               const uint32_t timeout_ms = 1000L) {
     if (!buf) { return false; }
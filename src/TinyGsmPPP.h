@@ -0,0 +1,473 @@
+/**
+ * @file       TinyGsmPPP.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMPPP_H_
+#define SRC_TINYGSMPPP_H_
+
+#include "TinyGsmCommon.h"
+
+// PPP over the modem's serial port, with the IP stack the platform already
+// has (lwIP, as on the ESP32) doing the rest.  Needs lwIP built with
+// PPP_SUPPORT and PPPOS_SUPPORT.  The client also needs LWIP_SOCKET, which
+// lwIP only has with an OS (not with NO_SYS), and LWIP_DNS to connect by name.
+#include <errno.h>
+#include <string.h>
+#include <lwip/opt.h>
+#include <lwip/def.h>
+#include <lwip/netif.h>
+#include <netif/ppp/pppos.h>
+#if LWIP_PPP_API
+#include <netif/ppp/pppapi.h>
+#endif
+#if LWIP_SOCKET
+#include <lwip/sockets.h>
+#endif
+#if LWIP_DNS
+#include <lwip/dns.h>
+#endif
+#if !NO_SYS
+#include <lwip/tcpip.h>
+#endif
+
+#if !PPP_SUPPORT || !PPPOS_SUPPORT
+#error TinyGsmPPP needs lwIP built with PPP_SUPPORT and PPPOS_SUPPORT
+#endif
+
+// From another thread than lwIP's own, the PPP calls go through its API
+#if LWIP_PPP_API && !NO_SYS
+#define TINY_GSM_PPP_CALL(fn) pppapi_##fn
+#else
+#define TINY_GSM_PPP_CALL(fn) ppp_##fn
+#endif
+
+// A PPP link dialled with ATD*99# on a modem (or on a CMUX channel, which
+// leaves the others free for AT commands while the link is up).  Once up,
+// TinyGsmPPP::Client connects any number of sockets over it, as fast as the
+// line goes, with none of the modem's socket commands involved.
+//
+//   TinyGsmPPP ppp(SerialAT);
+//   ppp.begin(apn);
+//   TinyGsmPPP::Client client(ppp);
+//   client.connect(server, 80);
+//   ...
+//   ppp.loop();  // often, from loop() or a task of its own
+//
+// The client's calls feed the link themselves while they wait, so loop() only
+// has to run on its own when nothing else is being called.
+class TinyGsmPPP {
+ public:
+#if LWIP_SOCKET
+  /*
+   * Socket client
+   */
+  // A TCP socket of the IP stack.  It reads and writes through the stack's
+  // buffers, feeding the link from the modem while it waits.
+  class Client : public ::Client {
+   public:
+    Client() {}
+    explicit Client(TinyGsmPPP& ppp) : ppp(&ppp) {}
+
+    ~Client() {
+      stop();
+    }
+
+    bool init(TinyGsmPPP* ppp) {
+      this->ppp = ppp;
+      return true;
+    }
+
+    int connect(const char* host, uint16_t port, int timeout_s) {
+      stop();
+      if (!ppp || !ppp->connected()) { return false; }
+      uint32_t   timeout_ms  = ((uint32_t)timeout_s) * 1000;
+      uint32_t   startMillis = millis();
+      ip4_addr_t ip;
+      if (!ppp->lookup(host, ip, timeout_ms)) { return false; }
+      struct sockaddr_in addr = {};
+      addr.sin_family         = AF_INET;
+      addr.sin_port           = lwip_htons(port);
+      addr.sin_addr.s_addr    = ip4_addr_get_u32(&ip);
+
+      uint32_t spent = millis() - startMillis;
+      if (spent >= timeout_ms) { return false; }
+      return open(addr, timeout_ms - spent);
+    }
+    int connect(IPAddress ip, uint16_t port, int timeout_s) {
+      uint32_t a = static_cast<uint32_t>(ip[0]) << 24 |
+                   static_cast<uint32_t>(ip[1]) << 16 |
+                   static_cast<uint32_t>(ip[2]) << 8 | ip[3];
+      struct sockaddr_in addr = {};
+      addr.sin_family         = AF_INET;
+      addr.sin_port           = lwip_htons(port);
+      addr.sin_addr.s_addr    = lwip_htonl(a);
+      stop();
+      if (!ppp || !ppp->connected()) { return false; }
+      return open(addr, ((uint32_t)timeout_s) * 1000);
+    }
+    int connect(const char* host, uint16_t port) override {
+      return connect(host, port, 75);
+    }
+    int connect(IPAddress ip, uint16_t port) override {
+      return connect(ip, port, 75);
+    }
+
+    void stop() override {
+      if (sock < 0) { return; }
+      lwip_close(sock);
+      sock = -1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+      if (sock < 0) { return 0; }
+      size_t   sent        = 0;
+      uint32_t startMillis = millis();
+      while (sent < size) {
+        int n = lwip_send(sock, buf + sent, size - sent, MSG_DONTWAIT);
+        if (n > 0) {
+          sent += n;
+          startMillis = millis();
+          continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) { break; }
+        // The stack's send buffer is full until the link takes some out
+        if (millis() - startMillis >= _timeout) { break; }
+        ppp->loop();
+        TINY_GSM_YIELD();
+      }
+      return sent;
+    }
+
+    size_t write(uint8_t c) override {
+      return write(&c, 1);
+    }
+
+    int available() override {
+      if (sock < 0) { return 0; }
+      ppp->loop();
+      int n = 0;
+      if (lwip_ioctl(sock, FIONREAD, &n) < 0) { return 0; }
+      return n;
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+      if (sock < 0) { return -1; }
+      ppp->loop();
+      int n = lwip_recv(sock, buf, size, MSG_DONTWAIT);
+      if (n == 0) { stop(); }
+      return n > 0 ? n : 0;
+    }
+
+    int read() override {
+      uint8_t c;
+      if (read(&c, 1) == 1) { return c; }
+      return -1;
+    }
+
+    int peek() override {
+      if (sock < 0) { return -1; }
+      uint8_t c;
+      if (lwip_recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1) { return c; }
+      return -1;
+    }
+
+    void flush() override {}
+
+    // Closed once the far end has hung up and everything it sent is read
+    uint8_t connected() override {
+      if (sock < 0) { return false; }
+      ppp->loop();
+      uint8_t c;
+      int     n = lwip_recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+      if (n > 0) { return true; }
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stop();
+        return false;
+      }
+      return true;
+    }
+
+    operator bool() override {
+      return connected();
+    }
+
+   protected:
+    // Connects without blocking, feeding the link until it is done
+    bool open(const struct sockaddr_in& addr, uint32_t timeout_ms) {
+      sock = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      if (sock < 0) { return false; }
+      lwip_fcntl(sock, F_SETFL, O_NONBLOCK);
+      int rc = lwip_connect(sock, reinterpret_cast<const sockaddr*>(&addr),
+                            sizeof(addr));
+      if (rc < 0 && errno != EINPROGRESS) {
+        stop();
+        return false;
+      }
+      uint32_t startMillis = millis();
+      while (rc < 0) {
+        fd_set         wr;
+        struct timeval tv = {0, 0};
+        FD_ZERO(&wr);
+        FD_SET(sock, &wr);
+        if (lwip_select(sock + 1, NULL, &wr, NULL, &tv) > 0) {
+          int       err = 0;
+          socklen_t len = sizeof(err);
+          lwip_getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+          if (err) { break; }
+          rc = 0;
+        } else if (millis() - startMillis >= timeout_ms) {
+          break;
+        } else {
+          ppp->loop();
+          TINY_GSM_YIELD();
+        }
+      }
+      if (rc < 0) {
+        stop();
+        return false;
+      }
+      return true;
+    }
+
+    TinyGsmPPP* ppp  = NULL;
+    int         sock = -1;
+  };
+#endif
+
+  /*
+   * Link
+   */
+ public:
+  explicit TinyGsmPPP(Stream& stream) : stream(stream) {}
+
+  // Dials the packet data service on the modem, which must be answering AT
+  // commands and registered on the network, and waits for the link to come
+  // up with an address
+  bool begin(const char* apn, const char* user = NULL, const char* pwd = NULL,
+             uint32_t timeout_ms = 60000L) {
+    if (!pcb) {
+#if LWIP_PPP_API && !NO_SYS
+      pcb = pppapi_pppos_create(&ppp_if, output, status, this);
+#else
+      pcb = pppos_create(&ppp_if, output, status, this);
+#endif
+      if (!pcb) { return false; }
+    }
+    stream.print(GF("AT+CGDCONT=1,\"IP\",\""));
+    stream.print(apn);
+    stream.print(GF("\"\r\n"));
+    if (!waitFor(GF("OK\r\n"), 5000L)) { return false; }
+    stream.print(GF("ATD*99#\r\n"));
+    if (!waitFor(GF("CONNECT"), 30000L)) { return false; }
+    skipLine();
+
+#if PPP_AUTH_SUPPORT
+    if (user && *user) {
+      TINY_GSM_PPP_CALL(set_auth)(pcb, PPPAUTHTYPE_ANY, user, pwd ? pwd : "");
+    }
+#endif
+    TINY_GSM_PPP_CALL(set_default)(pcb);
+#if LWIP_DNS
+    // Names are looked up with the servers the network hands out
+    ppp_set_usepeerdns(pcb, 1);
+#endif
+    up   = false;
+    dead = false;
+    TINY_GSM_PPP_CALL(connect)(pcb, 0);
+
+    uint32_t startMillis = millis();
+    while (!up && !dead && millis() - startMillis < timeout_ms) {
+      loop();
+      TINY_GSM_YIELD();
+    }
+    if (!up) { end(); }
+    return up;
+  }
+
+  // Hangs up, leaving the modem in command mode
+  void end() {
+    if (pcb && !dead) {
+      TINY_GSM_PPP_CALL(close)(pcb, 0);
+      uint32_t startMillis = millis();
+      while (!dead && millis() - startMillis < 5000L) {
+        loop();
+        TINY_GSM_YIELD();
+      }
+    }
+    up = false;
+    // In case the modem did not take the LCP terminate as the end
+    delay(1000);
+    stream.print(GF("+++"));
+    delay(1000);
+    stream.print(GF("ATH\r\n"));
+    waitFor(GF("OK\r\n"), 2000L);
+  }
+
+  // Feeds the IP stack what has come in from the modem
+  void loop() {
+    uint8_t buf[64];
+    while (pcb && stream.available()) {
+      int n = stream.readBytes(buf, TinyGsmMin(sizeof(buf),
+                               static_cast<size_t>(stream.available())));
+      if (n <= 0) { break; }
+#if !NO_SYS && !PPP_INPROC_IRQ_SAFE
+      pppos_input_tcpip(pcb, buf, n);
+#else
+      pppos_input(pcb, buf, n);
+#endif
+    }
+#if NO_SYS
+    sys_check_timeouts();
+#endif
+  }
+
+  bool connected() const {
+    return up;
+  }
+
+  IPAddress localIP() const {
+    return ip;
+  }
+
+  /*
+   * Name lookup
+   */
+ protected:
+  // Resolves a name with the stack's DNS client, feeding the link until the
+  // answer comes back (lwip_getaddrinfo() would block with nothing feeding
+  // it).  One lookup at a time; a late answer to one given up is dropped.
+  bool lookup(const char* host, ip4_addr_t& out, uint32_t timeout_ms) {
+#if LWIP_DNS
+    lookupHost  = host;
+    lookupState = 0;
+#if NO_SYS
+    lookupStart(this);
+#else
+    // The DNS client is not thread-safe, so it is started from lwIP's thread
+    if (tcpip_callback(lookupStart, this) != ERR_OK) { return false; }
+#endif
+    uint32_t startMillis = millis();
+    while (lookupState == 0 && !dead &&
+           millis() - startMillis < timeout_ms) {
+      loop();
+      TINY_GSM_YIELD();
+    }
+    if (lookupState != 1) {
+      lookupState = -1;
+      return false;
+    }
+    out = lookupAddr;
+    return true;
+#else
+    // Numeric addresses only
+    (void)timeout_ms;
+    return ip4addr_aton(host, &out);
+#endif
+  }
+
+#if LWIP_DNS
+  static void lookupStart(void* ctx) {
+    TinyGsmPPP* self = static_cast<TinyGsmPPP*>(ctx);
+    ip_addr_t   addr;
+    err_t       err = dns_gethostbyname(self->lookupHost.c_str(), &addr,
+                                        lookupDone, self);
+    if (err == ERR_OK) {
+      lookupDone(self->lookupHost.c_str(), &addr, self);
+    } else if (err != ERR_INPROGRESS) {
+      self->lookupState = -1;
+    }
+  }
+
+  static void lookupDone(const char* name, const ip_addr_t* addr, void* ctx) {
+    TinyGsmPPP* self = static_cast<TinyGsmPPP*>(ctx);
+    if (self->lookupState != 0 || strcmp(name, self->lookupHost.c_str())) {
+      return;
+    }
+    if (addr && IP_IS_V4(addr)) {
+      self->lookupAddr  = *ip_2_ip4(addr);
+      self->lookupState = 1;
+    } else {
+      self->lookupState = -1;
+    }
+  }
+#endif
+
+  /*
+   * lwIP callbacks
+   */
+ protected:
+#if LWIP_VERSION_MAJOR == 2 && LWIP_VERSION_MINOR == 0
+  static u32_t output(ppp_pcb*, u8_t* data, u32_t len, void* ctx) {
+#else
+  static u32_t output(ppp_pcb*, const void* data, u32_t len, void* ctx) {
+#endif
+    TinyGsmPPP* self = static_cast<TinyGsmPPP*>(ctx);
+    return self->stream.write(static_cast<const uint8_t*>(data), len);
+  }
+
+  static void status(ppp_pcb* pcb, int err, void* ctx) {
+    TinyGsmPPP* self = static_cast<TinyGsmPPP*>(ctx);
+    if (err == PPPERR_NONE) {
+      const ip4_addr_t* addr = netif_ip4_addr(ppp_netif(pcb));
+      uint32_t          a    = lwip_ntohl(ip4_addr_get_u32(addr));
+      self->ip   = IPAddress(a >> 24, a >> 16, a >> 8, a);
+      self->up   = true;
+      DBG("### PPP up:", self->ip);
+      return;
+    }
+    // Any error, or the close asked for, ends the link
+    DBG("### PPP down:", err);
+    self->up   = false;
+    self->dead = true;
+  }
+
+  /*
+   * Utilities
+   */
+ protected:
+  // Waits for text (in flash) on the port, while it is still in AT mode
+  bool waitFor(GsmConstStr text, uint32_t timeout_ms) {
+    const char* p           = reinterpret_cast<const char*>(text);
+    size_t      seen        = 0;
+    uint32_t    startMillis = millis();
+    while (millis() - startMillis < timeout_ms) {
+      int c = stream.read();
+      if (c < 0) {
+        TINY_GSM_YIELD();
+        continue;
+      }
+      if (c == TINY_GSM_PGM_BYTE(p + seen)) {
+        if (!TINY_GSM_PGM_BYTE(p + ++seen)) { return true; }
+      } else {
+        seen = (c == TINY_GSM_PGM_BYTE(p)) ? 1 : 0;
+      }
+    }
+    return false;
+  }
+
+  void skipLine() {
+    uint32_t startMillis = millis();
+    while (millis() - startMillis < 1000L) {
+      if (stream.read() == '\n') { return; }
+    }
+  }
+
+  Stream&       stream;
+  ppp_pcb*      pcb = NULL;
+  struct netif  ppp_if;
+  IPAddress     ip;
+  volatile bool up   = false;
+  volatile bool dead = false;
+#if LWIP_DNS
+  // The name lookup under way: 0 while waiting, 1 found, -1 failed
+  String          lookupHost;
+  ip4_addr_t      lookupAddr;
+  volatile int8_t lookupState = -1;
+#endif
+};
+
+#endif  // SRC_TINYGSMPPP_H_
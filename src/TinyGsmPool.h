@@ -0,0 +1,254 @@
+/**
+ * @file       TinyGsmPool.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMPOOL_H_
+#define SRC_TINYGSMPOOL_H_
+
+#include "TinyGsmCommon.h"
+
+#if !defined(TINY_GSM_RX_POOL_CHUNK)
+#define TINY_GSM_RX_POOL_CHUNK 64
+#endif
+
+#if defined(TINY_GSM_RX_POOL) && \
+    TINY_GSM_RX_POOL / TINY_GSM_RX_POOL_CHUNK > 254
+#error TINY_GSM_RX_POOL can hold at most 254 chunks
+#endif
+
+#if defined(TINY_GSM_RX_POOL) && defined(TINY_GSM_FIFO_ATOMIC)
+#error The shared RX pool cannot be fed from an interrupt or another thread
+#endif
+
+// A fixed arena of equal chunks, handed out to the receive buffers of all
+// clients as they need them and taken back as soon as they are read.  The
+// chunks are linked through a table of 1-byte indexes, so the overhead is a
+// byte per chunk.
+template <uint16_t chunkSize, uint8_t chunkCount>
+class TinyGsmPool {
+ public:
+  static const uint8_t  NONE = 0xFF;
+  static const uint16_t SIZE = chunkSize;
+
+  // The one pool that all clients share
+  static TinyGsmPool& instance() {
+    static TinyGsmPool pool;
+    return pool;
+  }
+
+  // Returns a chunk, or NONE when the pool is used up
+  uint8_t alloc() {
+    uint8_t c = _free;
+    if (c == NONE) { return NONE; }
+    _free    = _next[c];
+    _next[c] = NONE;
+    _avail--;
+    return c;
+  }
+
+  void release(uint8_t c) {
+    _next[c] = _free;
+    _free    = c;
+    _avail++;
+  }
+
+  uint8_t* data(uint8_t c) {
+    return _b[c];
+  }
+
+  // The chunk following c in its owner's chain
+  uint8_t& next(uint8_t c) {
+    return _next[c];
+  }
+
+  // Number of chunks not in use
+  uint8_t available() const {
+    return _avail;
+  }
+
+ protected:
+  TinyGsmPool() : _free(0), _avail(chunkCount) {
+    for (uint8_t i = 0; i < chunkCount; i++) {
+      _next[i] = (i + 1 < chunkCount) ? i + 1 : NONE;
+    }
+  }
+
+  uint8_t _b[chunkCount][chunkSize];
+  uint8_t _next[chunkCount];
+  uint8_t _free;
+  uint8_t _avail;
+};
+
+// A receive FIFO with the same interface as TinyGsmFifo, built from a chain
+// of pool chunks.  It holds no memory of its own while it is empty, and can
+// grow as far as the pool allows.
+template <class Pool>
+class TinyGsmPoolFifo {
+ public:
+  struct Span {
+    uint8_t* data;
+    size_t   size;
+  };
+
+  TinyGsmPoolFifo()
+      : _head(Pool::NONE), _tail(Pool::NONE), _r(0), _w(0), _size(0) {}
+
+  ~TinyGsmPoolFifo() {
+    clear();
+  }
+
+  void clear() {
+    Pool& pool = Pool::instance();
+    while (_head != Pool::NONE) {
+      uint8_t c = pool.next(_head);
+      pool.release(_head);
+      _head = c;
+    }
+    _tail = Pool::NONE;
+    _r    = 0;
+    _w    = 0;
+    _size = 0;
+  }
+
+  /*
+   * Writing
+   */
+  bool writeable() {
+    return free() > 0;
+  }
+
+  // What could be written right now: the rest of the last chunk plus every
+  // chunk still in the pool
+  int free() {
+    int f = Pool::instance().available() * Pool::SIZE;
+    if (_tail != Pool::NONE) { f += Pool::SIZE - _w; }
+    return f;
+  }
+
+  bool put(const uint8_t& c) {
+    Span s = writableSpan();
+    if (!s.size) { return false; }
+    *s.data = c;
+    commit(1);
+    return true;
+  }
+
+  int put(const uint8_t* p, int n) {
+    int c = n;
+    while (c > 0) {
+      Span s = writableSpan();
+      if (!s.size) { break; }
+      size_t f = TinyGsmMin(static_cast<size_t>(c), s.size);
+      memcpy(s.data, p, f);
+      commit(f);
+      p += f;
+      c -= f;
+    }
+    return n - c;
+  }
+
+  // The free space left in the last chunk, taking a new chunk from the pool
+  // when that one is full
+  Span writableSpan() {
+    Pool& pool = Pool::instance();
+    Span  s    = {NULL, 0};
+    if (_tail == Pool::NONE || _w == Pool::SIZE) {
+      uint8_t c = pool.alloc();
+      if (c == Pool::NONE) { return s; }
+      if (_tail == Pool::NONE) {
+        _head = c;
+      } else {
+        pool.next(_tail) = c;
+      }
+      _tail = c;
+      _w    = 0;
+    }
+    s.data = pool.data(_tail) + _w;
+    s.size = Pool::SIZE - _w;
+    return s;
+  }
+
+  void commit(size_t n) {
+    _w += n;
+    _size += n;
+  }
+
+  /*
+   * Reading
+   */
+  bool readable() {
+    return _size > 0;
+  }
+
+  size_t size() {
+    return _size;
+  }
+
+  bool get(uint8_t* p) {
+    Span s = readableSpan();
+    if (!s.size) { return false; }
+    *p = *s.data;
+    consume(1);
+    return true;
+  }
+
+  int get(uint8_t* p, int n) {
+    int c = n;
+    while (c > 0) {
+      Span s = readableSpan();
+      if (!s.size) { break; }
+      size_t f = TinyGsmMin(static_cast<size_t>(c), s.size);
+      memcpy(p, s.data, f);
+      consume(f);
+      p += f;
+      c -= f;
+    }
+    return n - c;
+  }
+
+  // The unread data in the first chunk
+  Span readableSpan() {
+    Span s = {NULL, 0};
+    if (!_size) { return s; }
+    s.data = Pool::instance().data(_head) + _r;
+    s.size = ((_head == _tail) ? _w : Pool::SIZE) - _r;
+    return s;
+  }
+
+  // Drops n characters from the front, handing back the chunks that are done
+  void consume(size_t n) {
+    Pool& pool = Pool::instance();
+    _r += n;
+    _size -= n;
+    if (!_size) {
+      clear();
+    } else if (_r == Pool::SIZE) {
+      uint8_t c = pool.next(_head);
+      pool.release(_head);
+      _head = c;
+      _r    = 0;
+    }
+  }
+
+  uint8_t peek() {
+    Span s = readableSpan();
+    return s.size ? *s.data : 0;
+  }
+
+ protected:
+  // Chunks belong to a single FIFO
+  TinyGsmPoolFifo(const TinyGsmPoolFifo&);
+  TinyGsmPoolFifo& operator=(const TinyGsmPoolFifo&);
+
+  uint8_t  _head;
+  uint8_t  _tail;
+  uint16_t _r;
+  uint16_t _w;
+  size_t   _size;
+};
+
+#endif  // SRC_TINYGSMPOOL_H_
@@ -14,10 +14,49 @@
 #define TINY_GSM_MODEM_HAS_TCP
 
 #include "TinyGsmFifo.h"
+#include "TinyGsmPool.h"
+
+#if !defined(TINY_GSM_MAX_READ)
+// The most asked of the modem in a single read command; the drivers for
+// modems with a buffer set their own limit
+#define TINY_GSM_MAX_READ 1024
+#endif
 
 #if !defined(TINY_GSM_RX_BUFFER)
+#if defined(TINY_GSM_READ_AHEAD)
+// Room for all one read command brings in, so a stream of small reads costs
+// one command per TINY_GSM_MAX_READ characters rather than one per FIFO-full
+#define TINY_GSM_RX_BUFFER (TINY_GSM_MAX_READ + 1)
+#else
 #define TINY_GSM_RX_BUFFER 64
 #endif
+#endif
+
+#if !defined(TINY_GSM_MAX_SEND)
+// The most sent to the modem in a single send command
+#define TINY_GSM_MAX_SEND 1024
+#endif
+
+#if !defined(TINY_GSM_POLL_MIN)
+// Some modules "forget" to notify about data arrival, so the modem is asked
+// now and then anyway: this soon after traffic on the socket, then twice as
+// long each time nothing has come, up to TINY_GSM_POLL_MAX.  Drivers for
+// modems whose URC's can be trusted set a longer TINY_GSM_POLL_MAX.
+#define TINY_GSM_POLL_MIN 50
+#endif
+#if !defined(TINY_GSM_POLL_MAX)
+#define TINY_GSM_POLL_MAX 2000
+#endif
+
+#if defined(TINY_GSM_TX_COALESCE)
+#if !defined(TINY_GSM_TX_BUFFER)
+#define TINY_GSM_TX_BUFFER TINY_GSM_MAX_SEND
+#endif
+#if !defined(TINY_GSM_TX_IDLE)
+// How long maintain() lets gathered data wait for more before sending it
+#define TINY_GSM_TX_IDLE 20
+#endif
+#endif
 
 // Because of the ordering of resolution of overrides in templates, these need
 // to be written out every time.  This macro is to shorten that.
@@ -47,10 +86,61 @@ class TinyGsmTCP {
   /*
    * Basic functions
    */
+  // Does nothing while a transparent client has the line in data mode, when
+  // the modem takes no AT commands until that client's commandMode()
   void maintain() {
+    if (inDataMode) { return; }
+#if defined(TINY_GSM_TX_COALESCE)
+    for (int mux = 0; mux < muxCount; mux++) {
+      GsmClient* sock = thisModem().sockets[mux];
+      if (sock && sock->tx_len &&
+          millis() - sock->tx_since >= TINY_GSM_TX_IDLE) {
+        sock->flushTx();
+      }
+    }
+#endif
     return thisModem().maintainImpl();
   }
 
+  /*
+   * Socket readiness
+   */
+  // Waits up to timeout_ms for any of the sockets in mask (bit n for mux n)
+  // to have data to read or to be closed, handling the modem's URC's in the
+  // meantime.  A closed socket stays ready until it is left out of the mask;
+  // one that has never been opened is not ready.
+  // Returns the mask of the sockets that are ready.
+  uint32_t pollSockets(uint32_t mask, uint32_t timeout_ms = 0) {
+    uint32_t startMillis = millis();
+    for (;;) {
+      uint32_t ready = readySockets(mask);
+      if (ready || millis() - startMillis >= timeout_ms) { return ready; }
+#if defined TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+      // As in available(), ask now and then in case a URC went missing
+      for (uint8_t mux = 0; mux < muxCount; mux++) {
+        GsmClient* sock = thisModem().sockets[mux];
+        if (sock && (mask & (1UL << mux))) { sock->pollForgotten(); }
+      }
+#endif
+      maintain();
+      TINY_GSM_YIELD();
+    }
+  }
+
+  // Like pollSockets(), but returns a single ready mux (or -1 if none is),
+  // taking turns so that one busy socket cannot keep the others waiting
+  int8_t nextReadySocket(uint32_t timeout_ms = 0, uint32_t mask = 0xFFFFFFFF) {
+    uint32_t ready = pollSockets(mask, timeout_ms);
+    for (uint8_t i = 1; i <= muxCount; i++) {
+      uint8_t mux = (pollLast + i) % muxCount;
+      if (ready & (1UL << mux)) {
+        pollLast = mux;
+        return mux;
+      }
+    }
+    return -1;
+  }
+
   /*
    * CRTP Helper
    */
@@ -69,7 +159,19 @@ class TinyGsmTCP {
   class GsmClient : public Client {
     // Make all classes created from the modem template friends
     friend class TinyGsmTCP<modemType, muxCount>;
+    // A GsmUDP sends and reads through a client of its own
+    template <class, uint8_t>
+    friend class TinyGsmUDP;
+    // With TINY_GSM_RX_POOL set to a number of bytes, the clients draw their
+    // receive buffers from one pool of that size, in TINY_GSM_RX_POOL_CHUNK
+    // pieces, instead of each holding a TINY_GSM_RX_BUFFER of its own
+#if defined(TINY_GSM_RX_POOL)
+    typedef TinyGsmPoolFifo<TinyGsmPool<
+        TINY_GSM_RX_POOL_CHUNK, TINY_GSM_RX_POOL / TINY_GSM_RX_POOL_CHUNK>>
+        RxFifo;
+#else
     typedef TinyGsmFifo<uint8_t, TINY_GSM_RX_BUFFER> RxFifo;
+#endif
 
    public:
     // bool init(modemType* modem, uint8_t);
@@ -109,8 +211,21 @@ class TinyGsmTCP {
     // Writes data out on the client using the modem send functionality
     size_t write(const uint8_t* buf, size_t size) override {
       TINY_GSM_YIELD();
+      sock_opened |= sock_connected;
+#if defined(TINY_GSM_TX_COALESCE)
+      // Small writes are gathered and sent together once the buffer is full,
+      // on flush(), before reading and when maintain() finds them idle
+      if (tx_len + size > sizeof(tx) && !flushTx()) { return 0; }
+      if (size < sizeof(tx)) {
+        if (!tx_len) { tx_since = millis(); }
+        memcpy(tx + tx_len, buf, size);
+        tx_len += size;
+        if (tx_len == sizeof(tx) && !flushTx()) { return 0; }
+        return size;
+      }
+#endif
       at->maintain();
-      return at->modemSend(buf, size, mux);
+      return sendChunks(buf, size);
     }
 
     size_t write(uint8_t c) override {
@@ -122,8 +237,59 @@ class TinyGsmTCP {
       return write((const uint8_t*)str, strlen(str));
     }
 
+    // Sends len characters read from src (ie, a file on an SD card) straight
+    // to the modem, without first gathering them in RAM.  Each send command
+    // only announces what src says it has available.  Stops early if src runs
+    // dry for a time-out period, or gives less than it said it had (the
+    // modem is then sent zeros for the rest of that piece, which are not
+    // counted).
+    // Returns the number of characters of src sent.
+    size_t writeFrom(Stream& src, size_t len) {
+      TINY_GSM_YIELD();
+      flushTx();
+      at->maintain();
+      size_t   sent        = 0;
+      uint32_t startMillis = millis();
+      while (sent < len) {
+        int avail = src.available();
+        if (avail <= 0) {
+          if (millis() - startMillis >= _timeout) { break; }
+          TINY_GSM_YIELD();
+          continue;
+        }
+        // Never promise the modem more than src already has
+        size_t chunk = TinyGsmMin(len - sent, static_cast<size_t>(avail));
+        chunk = TinyGsmMin(chunk, static_cast<size_t>(TINY_GSM_MAX_SEND));
+        at->sendStream = &src;
+        at->sendShort  = 0;
+        int n          = at->modemSend(NULL, chunk, mux);
+        at->sendStream = NULL;
+        if (n <= 0) { break; }
+        size_t took = TinyGsmMin(static_cast<size_t>(n), chunk);
+        sent += took > at->sendShort ? took - at->sendShort : 0;
+        if (took < chunk || at->sendShort) { break; }
+        startMillis = millis();
+      }
+      if (sent) { pollSoon(); }
+      return sent;
+    }
+
+    // Sends len characters kept in flash (PROGMEM) straight to the modem
+    // Returns the number of characters sent.
+    size_t writeFrom(const uint8_t* flashPtr, size_t len) {
+      TINY_GSM_YIELD();
+      flushTx();
+      at->maintain();
+      at->sendFlash = true;
+      size_t sent   = sendChunks(flashPtr, len);
+      at->sendFlash = false;
+      return sent;
+    }
+
     int available() override {
       TINY_GSM_YIELD();
+      sock_opened |= sock_connected;
+      flushTx();
 #if defined TINY_GSM_NO_MODEM_BUFFER
       // Returns the number of characters available in the TinyGSM fifo
       if (!rx.size() && sock_connected) { at->maintain(); }
@@ -140,12 +306,7 @@ class TinyGsmTCP {
       // fifo and the modem chips internal fifo, doing an extra check-in
       // with the modem to see if anything has arrived without a UURC.
       if (!rx.size()) {
-        if (millis() - prev_check > 500) {
-          // setting got_data to true will tell maintain to run
-          // modemGetAvailable(mux)
-          got_data   = true;
-          prev_check = millis();
-        }
+        pollForgotten();
         at->maintain();
       }
       return static_cast<uint16_t>(rx.size()) + sock_available;
@@ -157,6 +318,7 @@ class TinyGsmTCP {
 
     int read(uint8_t* buf, size_t size) override {
       TINY_GSM_YIELD();
+      flushTx();
       size_t cnt = 0;
 
 #if defined TINY_GSM_NO_MODEM_BUFFER
@@ -170,8 +332,13 @@ class TinyGsmTCP {
           buf += chunk;
           cnt += chunk;
           continue;
-        } /* TODO: Read directly into user buffer? */
-        if (!rx.size() && sock_connected) { at->maintain(); }
+        }
+        // Anything the URC's bring in goes straight into the user buffer
+        if (!rx.size() && sock_connected) {
+          size_t n = readDirect(buf, size - cnt, 0);
+          buf += n;
+          cnt += n;
+        }
       }
       return cnt;
 
@@ -186,12 +353,13 @@ class TinyGsmTCP {
           buf += chunk;
           cnt += chunk;
           continue;
-        } /* TODO: Read directly into user buffer? */
+        }
         at->maintain();
         if (sock_available > 0) {
-          int n = at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available),
-                                mux);
-          if (n == 0) break;
+          int n = readDirect(buf, size - cnt, sock_available);
+          if (n < 0) break;
+          buf += n;
+          cnt += n;
         } else {
           break;
         }
@@ -212,18 +380,13 @@ class TinyGsmTCP {
           continue;
         }
         // Workaround: Some modules "forget" to notify about data arrival
-        if (millis() - prev_check > 500) {
-          // setting got_data to true will tell maintain to run
-          // modemGetAvailable()
-          got_data   = true;
-          prev_check = millis();
-        }
-        // TODO(vshymanskyy): Read directly into user buffer?
+        pollForgotten();
         at->maintain();
         if (sock_available > 0) {
-          int n = at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available),
-                                mux);
-          if (n == 0) break;
+          int n = readDirect(buf, size - cnt, sock_available);
+          if (n < 0) break;
+          buf += n;
+          cnt += n;
         } else {
           break;
         }
@@ -241,11 +404,58 @@ class TinyGsmTCP {
       return -1;
     }
 
+    // Reads up to maxLen characters into sink (ie, a file or a hash), passing
+    // on the modem's data as it is read rather than through the FIFO.  Waits
+    // up to timeout ms for more to arrive.  Whatever the sink does not take
+    // is left to be read(), and nothing more is fetched once it refuses.  A
+    // sink whose availableForWrite() gives its free space gets the modem's
+    // data in pieces of that size; any other is fed a FIFO-full at a time.
+    // Returns the number of characters written to sink.
+    size_t readTo(Print& sink, size_t maxLen, uint32_t timeout) {
+      TINY_GSM_YIELD();
+      flushTx();
+      size_t   cnt         = 0;
+      uint32_t startMillis = millis();
+      while (cnt < maxLen) {
+        // Anything already in the FIFO goes first
+        typename RxFifo::Span span = rx.readableSpan();
+        if (span.size) {
+          size_t n = TinyGsmMin(span.size, maxLen - cnt);
+          n        = sink.write(span.data, n);
+          rx.consume(n);
+          cnt += n;
+          if (!n) { break; }
+          startMillis = millis();
+          continue;
+        }
+        if (millis() - startMillis >= timeout) { break; }
+#if defined TINY_GSM_NO_MODEM_BUFFER
+        if (!sock_connected) { break; }
+        int n = readDirect(NULL, maxLen - cnt, 0, &sink);
+#else
+        available();  // Checks with the modem, as available() would
+        if (sock_available <= 0) {
+          if (!sock_connected) { break; }
+          continue;
+        }
+        int n = readDirect(NULL, maxLen - cnt, sock_available, &sink);
+#endif
+        // Once the sink refuses, what it left is in the FIFO and the next
+        // turn of the loop ends it
+        if (n > 0) {
+          cnt += n;
+          startMillis = millis();
+        }
+      }
+      return cnt;
+    }
+
 	int peek() override {
 		return (uint8_t)rx.peek();
 	}
 
     void flush() override {
+      flushTx();
       at->stream.flush();
     }
 
@@ -278,7 +488,139 @@ class TinyGsmTCP {
 
     String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
 
+    // True while a connection started with connectAsync() (on the modems
+    // that have it) is still being made.  Runs maintain(), which takes in the
+    // modem's report; gives up once the connectAsync() time-out has passed.
+    // connected() then tells whether it worked.
+    bool connecting() {
+      if (!sock_connecting) { return false; }
+      at->maintain();
+      if (sock_connecting && millis() - connect_start >= connect_timeout) {
+        sock_connecting = false;
+      }
+      return sock_connecting;
+    }
+
    protected:
+    // For connectAsync(): marks the client as connecting before the command
+    // goes out, so that a quick report from the modem is not missed
+    void startConnect(int timeout_s) {
+      sock_connected  = false;
+      sock_connecting = true;
+      connect_start   = millis();
+      connect_timeout = static_cast<uint32_t>(timeout_s) * 1000;
+    }
+
+    // ... and after, with whether the modem took the command.  Returns false
+    // if the connection has already failed.
+    bool connectStarted(bool accepted) {
+      if (!accepted) { sock_connecting = false; }
+      return sock_connecting || sock_connected;
+    }
+
+    // Sends any amount of data, split into the most the modem takes in one
+    // send command.  The drivers put the modems that can into a send mode
+    // that answers as soon as the data is buffered (+CIPQSEND=1 on SIM800
+    // and SIM7000, +CIPSENDMODE=0 on SIM7600 and SIM5360), so each piece
+    // only waits on the serial line, not on the network.
+    // Returns the number of characters the modem accepted.
+    size_t sendChunks(const uint8_t* buf, size_t size) {
+      size_t sent = 0;
+      while (sent < size) {
+        size_t chunk = TinyGsmMin(size - sent,
+                                  static_cast<size_t>(TINY_GSM_MAX_SEND));
+        int    n     = at->modemSend(buf + sent, chunk, mux);
+        if (n <= 0) { break; }
+        sent += TinyGsmMin(static_cast<size_t>(n), chunk);
+        if (static_cast<size_t>(n) < chunk) { break; }
+      }
+      if (sent) { pollSoon(); }
+      return sent;
+    }
+
+    // Sends whatever write() has gathered.  Returns false if the modem did
+    // not take all of it, in which case the rest is dropped.
+    bool flushTx() {
+#if defined(TINY_GSM_TX_COALESCE)
+      if (!tx_len) { return true; }
+      size_t len = tx_len;
+      tx_len     = 0;
+      at->maintain();
+      return sendChunks(tx, len) == len;
+#else
+      return true;
+#endif
+    }
+
+    // Fetches more data once the FIFO is empty, letting the modem's payload
+    // go straight into the user buffer (or sink) and leaving only what does
+    // not fit there in the FIFO.  Without a buffer on the modem, this only
+    // listens for the URC's that push the data.
+    // Returns the number of characters put in buf (or taken by the sink), or
+    // -1 if the modem had nothing to give.
+    int readDirect(uint8_t* buf, size_t size, uint16_t toRead,
+                   Print* sink = NULL) {
+      direct_buf  = buf;
+      direct_sink = sink;
+      direct_size = size;
+      int res     = 0;
+#if defined TINY_GSM_NO_MODEM_BUFFER
+      (void)toRead;
+      at->maintain();
+#else
+      // Whatever the sink refuses has to fit in the FIFO, so beyond the FIFO's
+      // free space only as much is asked for as the sink says it will take
+      // (which a sink that cannot tell gives as 0)
+      size_t room = size;
+      if (sink) {
+        int avail = sink->availableForWrite();
+        room = avail > 0 ? TinyGsmMin(size, static_cast<size_t>(avail)) : 0;
+      }
+      size_t req = TinyGsmMin(room + rx.free(), static_cast<size_t>(toRead));
+      req        = TinyGsmMin(req, static_cast<size_t>(TINY_GSM_MAX_READ));
+      if (req && at->modemRead(req, mux) == 0) {
+        res = -1;
+      } else if (req) {
+        pollSoon();
+      }
+#endif
+      size_t got  = size - direct_size;
+      direct_buf  = NULL;
+      direct_sink = NULL;
+      direct_size = 0;
+      return got ? static_cast<int>(got) : res;
+    }
+
+    // Flags the socket for a check with the modem once poll_interval has
+    // passed since the last one, backing off while the checks find nothing
+    void pollForgotten() {
+#if defined TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+      if (millis() - prev_check < poll_interval) { return; }
+      // setting got_data to true will tell maintain to run
+      // modemGetAvailable(mux)
+      got_data      = true;
+      prev_check    = millis();
+      poll_interval = TinyGsmMin(2UL * poll_interval,
+                                 static_cast<unsigned long>(TINY_GSM_POLL_MAX));
+#endif
+    }
+
+    // After traffic a reply is likely, so polling starts over at its fastest
+    void pollSoon() {
+      poll_interval = TINY_GSM_POLL_MIN;
+    }
+
+    // Passes characters on to the readTo() sink.  Anything it refuses goes
+    // to the FIFO instead, as does everything after.
+    void writeToSink(const uint8_t* p, size_t n) {
+      size_t w = direct_sink->write(p, n);
+      direct_size -= w;
+      if (w < n) {
+        direct_sink = NULL;
+        rx.put(p + w, n - w);
+      }
+    }
+
     // Read and dump anything remaining in the modem's internal buffer.
     // Using this in the client stop() function.
     // The socket will appear open in response to connected() even after it
@@ -292,7 +634,11 @@ class TinyGsmTCP {
       uint32_t startMillis = millis();
       while (sock_available > 0 && (millis() - startMillis < maxWaitMs)) {
         rx.clear();
-        at->modemRead(TinyGsmMin((uint16_t)rx.free(), sock_available), mux);
+        // Nothing can be read while the other clients hold the whole RX
+        // pool, and closing the socket drops what is left anyway
+        uint16_t len = TinyGsmMin((uint16_t)rx.free(), sock_available);
+        if (!len) { break; }
+        at->modemRead(len, mux);
       }
       rx.clear();
       at->streamClear();
@@ -308,11 +654,32 @@ class TinyGsmTCP {
 
     modemType* at;
     uint8_t    mux;
-    uint16_t   sock_available;
+    uint16_t   sock_available = 0;
     uint32_t   prev_check;
     bool       sock_connected;
     bool       got_data;
     RxFifo     rx;
+    // Where incoming characters go ahead of the FIFO while read() or readTo()
+    // waits, and how many more they want
+    uint8_t* direct_buf  = NULL;
+    Print*   direct_sink = NULL;
+    size_t   direct_size = 0;
+    // How long pollForgotten() waits before the next check with the modem
+    uint16_t poll_interval = TINY_GSM_POLL_MIN;
+    // A connectAsync() waiting on the modem, and since when and how long
+    bool     sock_connecting = false;
+    uint32_t connect_start   = 0;
+    uint32_t connect_timeout = 0;
+    // Set once the socket is seen connected, so that readySockets() can tell
+    // a closed socket from one never opened
+    bool sock_opened = false;
+    // Set when the socket belongs to a GsmUDP and so is read by the datagram
+    bool sock_udp = false;
+#if defined(TINY_GSM_TX_COALESCE)
+    uint8_t  tx[TINY_GSM_TX_BUFFER];
+    uint16_t tx_len   = 0;
+    uint32_t tx_since = 0;  // When the oldest gathered data was written
+#endif
   };
 
   /*
@@ -321,15 +688,9 @@ class TinyGsmTCP {
  protected:
   void maintainImpl() {
 #if defined TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
-    // Keep listening for modem URC's and proactively iterate through
-    // sockets asking if any data is avaiable
-    for (int mux = 0; mux < muxCount; mux++) {
-      GsmClient* sock = thisModem().sockets[mux];
-      if (sock && sock->got_data) {
-        sock->got_data       = false;
-        sock->sock_available = thisModem().modemGetAvailable(mux);
-      }
-    }
+    // Keep listening for modem URC's and proactively ask the sockets that
+    // have been flagged if any data is avaiable
+    thisModem().modemRefreshSockets();
     while (thisModem().stream.available()) {
       thisModem().waitResponse(15, NULL, NULL);
     }
@@ -343,8 +704,24 @@ class TinyGsmTCP {
 #endif
   }
 
+#if defined TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+  // Updates sock_available (and with it sock_connected) of every socket
+  // flagged got_data, asking the modem about one socket at a time.  Drivers
+  // for modems that can report on all their sockets in one command replace
+  // this to save a round trip per socket.
+  void modemRefreshSockets() {
+    for (int mux = 0; mux < muxCount; mux++) {
+      GsmClient* sock = thisModem().sockets[mux];
+      if (sock && sock->got_data) {
+        sock->got_data       = false;
+        sock->sock_available = thisModem().modemGetAvailable(mux);
+      }
+    }
+  }
+#endif
+
   // Yields up to a time-out period and then reads a character from the stream
-  // into the mux FIFO
+  // into the mux FIFO (or where read() or readTo() wants it)
   // TODO(SRGDamia1):  Do we need to wait two _timeout periods for no
   // character return?  Will wait once in the first "while
   // !stream.available()" and then will wait again in the stream.read()
@@ -356,9 +733,144 @@ class TinyGsmTCP {
            (millis() - startMillis < thisModem().sockets[mux]->_timeout)) {
       TINY_GSM_YIELD();
     }
-    char c = thisModem().stream.read();
-    thisModem().sockets[mux]->rx.put(c);
+    moveCharToSocket(mux, thisModem().stream.read());
+  }
+
+  // Puts a character the driver has already taken from the stream (ie,
+  // decoded from HEX) where read() or readTo() wants it, or in the mux FIFO
+  inline void moveCharToSocket(uint8_t mux, uint8_t c) {
+    GsmClient* sock = thisModem().sockets[mux];
+    if (!sock) return;
+    if (sock->direct_size && sock->direct_sink) {
+      sock->writeToSink(&c, 1);
+    } else if (sock->direct_size && sock->direct_buf) {
+      *sock->direct_buf++ = c;
+      sock->direct_size--;
+    } else {
+      sock->rx.put(c);
+    }
   }
+
+  // Moves len characters from the stream into the mux FIFO (or straight into
+  // the user buffer or sink while read() or readTo() waits), reading what the
+  // UART already holds in one go rather than a character at a time.  Gives
+  // up once nothing has arrived for a time-out period.
+  // Returns the number of characters moved.
+  inline size_t moveCharsFromStreamToFifo(uint8_t mux, size_t len) {
+    GsmClient* sock = thisModem().sockets[mux];
+    if (!sock) return 0;
+    uint8_t  buf[64];
+    size_t   moved       = 0;
+    uint32_t startMillis = millis();
+    while (moved < len && millis() - startMillis < sock->_timeout) {
+      int avail = thisModem().stream.available();
+      if (avail <= 0) {
+        TINY_GSM_YIELD();
+        continue;
+      }
+      size_t chunk = TinyGsmMin(len - moved, static_cast<size_t>(avail));
+      if (sock->direct_size && sock->direct_sink) {
+        chunk = TinyGsmMin(TinyGsmMin(chunk, sock->direct_size), sizeof(buf));
+        chunk = thisModem().stream.readBytes(buf, chunk);
+        sock->writeToSink(buf, chunk);
+      } else if (sock->direct_size && sock->direct_buf) {
+        // Straight into the user buffer
+        chunk = TinyGsmMin(chunk, sock->direct_size);
+        chunk = thisModem().stream.readBytes(sock->direct_buf, chunk);
+        sock->direct_buf += chunk;
+        sock->direct_size -= chunk;
+      } else if (sock->rx.writeable()) {
+        // Straight into the FIFO's free space
+        typename GsmClient::RxFifo::Span span = sock->rx.writableSpan();
+        chunk = TinyGsmMin(chunk, span.size);
+        chunk = thisModem().stream.readBytes(span.data, chunk);
+        sock->rx.commit(chunk);
+      } else {
+        // With the FIFO full the characters are lost.  Reads are sized to
+        // what the FIFO and the reader can take, so only a modem that pushes
+        // its data unasked gets here.
+        DBG("### FIFO full, dropping data on", mux);
+        chunk = TinyGsmMin(chunk, sizeof(buf));
+        chunk = thisModem().stream.readBytes(buf, chunk);
+      }
+      moved += chunk;
+      startMillis = millis();
+    }
+    return moved;
+  }
+
+  // Writes the payload of a send command to the modem: the buffer given to
+  // modemSend(), read from flash if need be, or the next len characters of
+  // the stream a client is sending from
+  inline void streamWritePayload(const void* buff, size_t len) {
+    if (sendStream) {
+      uint8_t buf[64];
+      while (len) {
+        size_t chunk = TinyGsmMin(len, sizeof(buf));
+        chunk        = sendStream->readBytes(buf, chunk);
+        if (!chunk) { break; }
+        thisModem().stream.write(buf, chunk);
+        len -= chunk;
+      }
+      // Should the stream come up short, the modem still expects the rest
+      sendShort += len;
+      while (len--) { thisModem().stream.write(static_cast<uint8_t>(0)); }
+    } else if (sendFlash) {
+      const char* p = reinterpret_cast<const char*>(buff);
+      while (len--) { thisModem().stream.write(TINY_GSM_PGM_BYTE(p++)); }
+    } else {
+      thisModem().stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+    }
+  }
+
+  // The i'th character of the payload, for modems that need it re-encoded.
+  // Must be asked for in order.
+  inline uint8_t payloadByte(const void* buff, size_t i) {
+    if (sendStream) {
+      uint8_t c = 0;
+      if (sendStream->readBytes(&c, 1) != 1) { sendShort++; }
+      return c;
+    }
+    const char* p = reinterpret_cast<const char*>(buff) + i;
+    if (sendFlash) { return TINY_GSM_PGM_BYTE(p); }
+    return *p;
+  }
+
+  // Completes a connectAsync() when the driver's URC handler sees the modem's
+  // report on it
+  void connectFinished(int mux, bool ok) {
+    if (mux < 0 || mux >= muxCount) { return; }
+    GsmClient* sock = thisModem().sockets[mux];
+    if (!sock || !sock->sock_connecting) { return; }
+    sock->sock_connecting = false;
+    sock->sock_connected  = ok;
+    sock->sock_opened |= ok;
+    DBG("### Connected:", ok, "on", mux);
+  }
+
+  // The sockets in mask with something to read or that have closed, going
+  // only by what the URC's have already said.  A socket never opened is not
+  // closed, just idle.
+  uint32_t readySockets(uint32_t mask) {
+    uint32_t ready = 0;
+    for (uint8_t mux = 0; mux < muxCount; mux++) {
+      GsmClient* sock = thisModem().sockets[mux];
+      if (!sock || !(mask & (1UL << mux))) { continue; }
+      sock->sock_opened |= sock->sock_connected;
+      if (sock->rx.size() || sock->sock_available > 0 ||
+          (!sock->sock_connected && !sock->sock_connecting &&
+           sock->sock_opened)) {
+        ready |= 1UL << mux;
+      }
+    }
+    return ready;
+  }
+
+  Stream* sendStream = NULL;
+  size_t  sendShort  = 0;  // Characters sendStream did not have
+  bool    sendFlash  = false;
+  uint8_t pollLast   = 0;
+  bool    inDataMode = false;
 };
 
 #endif  // SRC_TINYGSMTCP_H_
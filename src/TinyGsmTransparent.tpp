@@ -0,0 +1,274 @@
+/**
+ * @file       TinyGsmTransparent.tpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMTRANSPARENT_H_
+#define SRC_TINYGSMTRANSPARENT_H_
+
+#include "TinyGsmTCP.tpp"
+
+#define TINY_GSM_MODEM_HAS_TRANSPARENT
+
+// The quiet time the modem wants on either side of the "+++" escape, in ms
+#if !defined(TINY_GSM_GUARD_TIME)
+#define TINY_GSM_GUARD_TIME 1000
+#endif
+
+// // What the modem prints when the connection drops while in data mode,
+// // after which it is back in command mode
+// #define TINY_GSM_DATA_MODE_END "NO CARRIER"
+
+template <class modemType, uint8_t muxCount>
+class TinyGsmTransparent {
+  /*
+   * Inner Transparent Client
+   */
+ public:
+  // A client that, once connected, turns the serial line over to the
+  // connection's raw data, so nothing is spent on send and read commands.
+  // While it is in data mode the modem cannot take AT commands: maintain()
+  // does nothing and the modem's other functions and clients must wait for
+  // commandMode() (or stop()).  The client goes back to data mode on its own
+  // when next used.
+  template <class clientType>
+  class GsmClientTransparent : public clientType {
+   public:
+    GsmClientTransparent() {}
+
+    explicit GsmClientTransparent(modemType& modem, uint8_t mux = 0)
+        : clientType(modem, mux) {}
+
+   public:
+    int connect(const char* host, uint16_t port, int timeout_s) override {
+      stop();
+      TINY_GSM_YIELD();
+      this->rx.clear();
+      uint8_t oldMux       = this->mux;
+      this->sock_connected = this->at->modemConnectTransparent(
+          host, port, &this->mux, timeout_s);
+      if (this->mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", this->mux);
+        this->at->sockets[oldMux] = NULL;
+      }
+      this->at->sockets[this->mux] = this;
+      if (this->sock_connected) { startDataMode(); }
+      return this->sock_connected;
+    }
+    int connect(IPAddress ip, uint16_t port, int timeout_s) {
+      return connect(this->TinyGsmStringFromIp(ip).c_str(), port, timeout_s);
+    }
+    int connect(const char* host, uint16_t port) override {
+      return connect(host, port, 75);
+    }
+    int connect(IPAddress ip, uint16_t port) override {
+      return connect(ip, port, 75);
+    }
+
+    void stop() override {
+      commandMode();
+      clientType::stop();
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+      if (!dataMode()) { return 0; }
+      return this->at->stream.write(buf, size);
+    }
+
+    size_t write(uint8_t c) override {
+      return write(&c, 1);
+    }
+
+    // As GsmClient::writeFrom(), with the characters going straight out
+    size_t writeFrom(Stream& src, size_t len) {
+      if (!dataMode()) { return 0; }
+      size_t   sent        = 0;
+      uint32_t startMillis = millis();
+      while (sent < len) {
+        int avail = src.available();
+        if (avail <= 0) {
+          if (millis() - startMillis >= this->_timeout) { break; }
+          TINY_GSM_YIELD();
+          continue;
+        }
+        // No length is announced, so only what src gives goes out
+        uint8_t buf[64];
+        size_t  chunk = TinyGsmMin(len - sent, static_cast<size_t>(avail));
+        chunk         = src.readBytes(buf, TinyGsmMin(chunk, sizeof(buf)));
+        if (!chunk) { break; }
+        this->at->stream.write(buf, chunk);
+        sent += chunk;
+        startMillis = millis();
+      }
+      return sent;
+    }
+
+    size_t writeFrom(const uint8_t* flashPtr, size_t len) {
+      if (!dataMode()) { return 0; }
+      this->at->sendFlash = true;
+      this->at->streamWritePayload(flashPtr, len);
+      this->at->sendFlash = false;
+      return len;
+    }
+
+    int available() override {
+      TINY_GSM_YIELD();
+      if (this->rx.size() || !dataMode()) { return this->rx.size(); }
+      return this->at->stream.available();
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+      TINY_GSM_YIELD();
+      size_t cnt = this->rx.get(buf, size);
+      if (cnt < size && dataMode()) { cnt += pull(buf + cnt, size - cnt); }
+      return cnt;
+    }
+
+    int read() override {
+      uint8_t c;
+      if (read(&c, 1) == 1) { return c; }
+      return -1;
+    }
+
+    int peek() override {
+      if (this->rx.size() || !dataMode()) { return this->rx.peek(); }
+      return this->at->stream.peek();
+    }
+
+    // As GsmClient::readTo(), reading the line itself
+    size_t readTo(Print& sink, size_t maxLen, uint32_t timeout) {
+      uint8_t  buf[64];
+      size_t   cnt         = 0;
+      uint32_t startMillis = millis();
+      while (cnt < maxLen) {
+        size_t n = TinyGsmMin(maxLen - cnt, sizeof(buf));
+        n        = read(buf, n);
+        if (n) {
+          size_t w = sink.write(buf, n);
+          // Whatever the sink refuses is left to be read()
+          if (w < n) { this->rx.put(buf + w, n - w); }
+          cnt += w;
+          if (w < n) { break; }
+          startMillis = millis();
+          continue;
+        }
+        if (!this->sock_connected || millis() - startMillis >= timeout) {
+          break;
+        }
+        TINY_GSM_YIELD();
+      }
+      return cnt;
+    }
+
+    void flush() override {
+      this->at->stream.flush();
+    }
+
+    uint8_t connected() override {
+      if (available()) { return true; }
+      return this->sock_connected;
+    }
+
+    /*
+     * Extended API
+     */
+    // Leaves data mode with the "+++" escape, keeping the connection open, so
+    // the modem takes AT commands again.  What arrives in the meantime is
+    // kept for read(), as far as the receive buffer goes.
+    bool commandMode() {
+      if (!in_data) { return true; }
+      // Nothing may be sent for a guard time either side of the escape
+      this->at->stream.flush();
+      drain(TINY_GSM_GUARD_TIME);
+      this->at->stream.write(reinterpret_cast<const uint8_t*>("+++"), 3);
+      this->at->stream.flush();
+      bool ok = this->at->waitResponse(2 * TINY_GSM_GUARD_TIME + 500) == 1;
+      // Without an OK the connection is taken to have dropped, which also
+      // ends data mode
+      if (!ok) { this->sock_connected = false; }
+      in_data              = false;
+      this->at->inDataMode = false;
+      return ok;
+    }
+
+    // Goes (back) to data mode, as the client does when it is next used
+    bool dataMode() {
+      if (in_data) { return true; }
+      if (!this->sock_connected || this->at->inDataMode) { return false; }
+      if (!this->at->modemEnterDataMode(this->mux)) { return false; }
+      startDataMode();
+      return true;
+    }
+
+   protected:
+    void startDataMode() {
+      in_data              = true;
+      this->at->inDataMode = true;
+      end_match            = 0;
+    }
+
+    // Takes in what the line already holds
+    size_t pull(uint8_t* buf, size_t size) {
+      size_t n = TinyGsmMin(size,
+                            static_cast<size_t>(this->at->stream.available()));
+      n        = this->at->stream.readBytes(buf, n);
+      watch(buf, n);
+      return n;
+    }
+
+    // Keeps what comes in for the read()s to come, until the line has been
+    // quiet for ms
+    void drain(uint32_t ms) {
+      uint32_t startMillis = millis();
+      while (millis() - startMillis < ms) {
+        while (this->at->stream.available()) {
+          uint8_t c = this->at->stream.read();
+          watch(&c, 1);
+          if (!in_data) { return; }
+          this->rx.put(c);
+          startMillis = millis();
+        }
+        TINY_GSM_YIELD();
+      }
+    }
+
+    // Looks for the modem giving up the connection.  The text is passed on as
+    // data, as there is no telling it apart.
+    void watch(const uint8_t* p, size_t n) {
+      static const char end[] = "\r\n" TINY_GSM_DATA_MODE_END "\r\n";
+      for (size_t i = 0; i < n; i++) {
+        if (p[i] == end[end_match]) {
+          end_match++;
+        } else {
+          end_match = (p[i] == end[0]) ? 1 : 0;
+        }
+        if (end_match == sizeof(end) - 1) {
+          DBG("### Data mode ended on", this->mux);
+          in_data              = false;
+          this->at->inDataMode = false;
+          this->sock_connected = false;
+          end_match            = 0;
+        }
+      }
+    }
+
+    bool    in_data   = false;
+    uint8_t end_match = 0;
+  };
+
+  /*
+   * CRTP Helper
+   */
+ protected:
+  inline const modemType& thisModem() const {
+    return static_cast<const modemType&>(*this);
+  }
+  inline modemType& thisModem() {
+    return static_cast<modemType&>(*this);
+  }
+};
+
+#endif  // SRC_TINYGSMTRANSPARENT_H_
@@ -0,0 +1,234 @@
+/**
+ * @file       TinyGsmUDP.tpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ */
+
+#ifndef SRC_TINYGSMUDP_H_
+#define SRC_TINYGSMUDP_H_
+
+#include "TinyGsmTCP.tpp"
+
+#if defined(ARDUINO_DASH)
+#include <ArduinoCompat/Udp.h>
+#else
+#include <Udp.h>
+#endif
+
+#define TINY_GSM_MODEM_HAS_UDP
+
+// The largest datagram that can be sent.  Datagrams received are cut to what
+// the receive buffer (TINY_GSM_RX_BUFFER) holds.
+#if !defined(TINY_GSM_UDP_TX_BUFFER)
+#define TINY_GSM_UDP_TX_BUFFER 64
+#endif
+
+// // For modules whose UDP sockets are opened to a single remote address, and
+// // so are opened again to send to another one
+// #define TINY_GSM_UDP_CONNECTED
+
+template <class modemType, uint8_t muxCount>
+class TinyGsmUDP {
+  /*
+   * Inner UDP socket
+   */
+ public:
+  // Arduino's UDP on one of the modem's sockets, which it takes up alongside
+  // the TCP clients.  The drivers name it for their own client class.
+  template <class clientType>
+  class GsmUDP : public UDP {
+   public:
+    GsmUDP() {
+      sock.sock_udp = true;
+    }
+
+    explicit GsmUDP(modemType& modem, uint8_t mux = 0) : sock(modem, mux) {
+      sock.sock_udp = true;
+    }
+
+    bool init(modemType* modem, uint8_t mux = 0) {
+      sock.sock_udp = true;
+      return sock.init(modem, mux);
+    }
+
+    // Opens the socket, to receive on localPort (or a port the modem picks
+    // when 0).  Where a socket only talks to one address it is opened on the
+    // first endPacket() instead, so replies can only come from there.
+    uint8_t begin(uint16_t localPort) override {
+      stop();
+      local_port = localPort;
+#if defined(TINY_GSM_UDP_CONNECTED)
+      return 1;
+#else
+      return open(NULL, 0);
+#endif
+    }
+
+    void stop() override {
+      if (sock.sock_connected) { sock.stop(); }
+      sock.rx.clear();
+      packet_left = 0;
+      tx_len      = 0;
+      tx_open     = false;
+      peer_port   = 0;
+    }
+
+    /*
+     * Sending
+     */
+    int beginPacket(IPAddress ip, uint16_t port) override {
+      return beginPacket(clientType::TinyGsmStringFromIp(ip).c_str(), port);
+    }
+
+    int beginPacket(const char* host, uint16_t port) override {
+      dest_host = host;
+      dest_port = port;
+      tx_len    = 0;
+      tx_open   = true;
+      return 1;
+    }
+
+    // Sends what was written since beginPacket() as one datagram
+    int endPacket() override {
+      if (!tx_open) { return 0; }
+      tx_open = false;
+#if defined(TINY_GSM_UDP_CONNECTED)
+      if (!sock.sock_connected || dest_port != peer_port ||
+          dest_host != peer_host) {
+        if (!open(dest_host.c_str(), dest_port)) { return 0; }
+      }
+#else
+      if (!sock.sock_connected && !open(NULL, 0)) { return 0; }
+#endif
+      sock.at->maintain();
+      int16_t sent = sock.at->modemSendTo(dest_host.c_str(), dest_port, tx,
+                                          tx_len, sock.mux);
+      sock.pollSoon();
+      return sent == static_cast<int16_t>(tx_len);
+    }
+
+    // Anything past TINY_GSM_UDP_TX_BUFFER is refused
+    size_t write(const uint8_t* buf, size_t size) override {
+      if (!tx_open) { return 0; }
+      size = TinyGsmMin(size, sizeof(tx) - tx_len);
+      memcpy(tx + tx_len, buf, size);
+      tx_len += size;
+      return size;
+    }
+
+    size_t write(uint8_t c) override {
+      return write(&c, 1);
+    }
+
+    /*
+     * Receiving
+     */
+    // Drops whatever is left of the last datagram and fetches the next one.
+    // Returns its size, or 0 if none has arrived.
+    int parsePacket() override {
+      sock.rx.clear();
+      packet_left = 0;
+      if (!sock.sock_connected || !sock.available()) { return 0; }
+      size_t size = TinyGsmMin(static_cast<size_t>(sock.rx.free()),
+                               static_cast<size_t>(TINY_GSM_MAX_READ));
+      // The drivers that do not say who sent it leave the peer in place
+      remote_ip   = peer_ip;
+      remote_port = peer_port;
+      sock.at->modemReadFrom(size, sock.mux, &remote_ip, &remote_port);
+      packet_left = sock.rx.size();
+      return packet_left;
+    }
+
+    int available() override {
+      return packet_left;
+    }
+
+    int read(unsigned char* buf, size_t size) override {
+      size_t n = TinyGsmMin(size, static_cast<size_t>(packet_left));
+      n        = sock.rx.get(buf, n);
+      packet_left -= n;
+      return n;
+    }
+
+    int read(char* buf, size_t size) override {
+      return read(reinterpret_cast<unsigned char*>(buf), size);
+    }
+
+    int read() override {
+      uint8_t c;
+      if (read(&c, 1) == 1) { return c; }
+      return -1;
+    }
+
+    int peek() override {
+      if (!packet_left) { return -1; }
+      return sock.rx.peek();
+    }
+
+    void flush() override {
+      sock.at->stream.flush();
+    }
+
+    // Where the datagram from parsePacket() came from
+    IPAddress remoteIP() override {
+      return remote_ip;
+    }
+
+    uint16_t remotePort() override {
+      return remote_port;
+    }
+
+   protected:
+    // Opens the socket, to host and port on the modems that need them
+    bool open(const char* host, uint16_t port) {
+      if (sock.sock_connected) { sock.stop(); }
+      sock.rx.clear();
+      uint8_t oldMux = sock.mux;
+      sock.sock_connected =
+          sock.at->modemOpenUdp(host, port, local_port, &sock.mux);
+      if (sock.mux != oldMux) {
+        DBG("WARNING:  Mux number changed from", oldMux, "to", sock.mux);
+        sock.at->sockets[oldMux] = NULL;
+      }
+      sock.at->sockets[sock.mux] = &sock;
+      if (host) {
+        peer_host = host;
+        peer_ip   = IPAddress();
+        peer_ip.fromString(host);
+      }
+      peer_port = port;
+      return sock.sock_connected;
+    }
+
+    clientType sock;
+    uint16_t   local_port  = 0;
+    uint16_t   packet_left = 0;
+    IPAddress  remote_ip;
+    uint16_t   remote_port = 0;
+    // The address a TINY_GSM_UDP_CONNECTED socket was opened to
+    String    peer_host;
+    IPAddress peer_ip;
+    uint16_t  peer_port = 0;
+    // The datagram being put together
+    String   dest_host;
+    uint16_t dest_port = 0;
+    uint8_t  tx[TINY_GSM_UDP_TX_BUFFER];
+    uint16_t tx_len  = 0;
+    bool     tx_open = false;
+  };
+
+  /*
+   * CRTP Helper
+   */
+ protected:
+  inline const modemType& thisModem() const {
+    return static_cast<const modemType&>(*this);
+  }
+  inline modemType& thisModem() {
+    return static_cast<modemType&>(*this);
+  }
+};
+
+#endif  // SRC_TINYGSMUDP_H_
@@ -0,0 +1,77 @@
+/**
+ * @file       Arduino.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Minimal host (Linux) stand-in for the Arduino core: timing functions plus
+ * the Print, Stream and String classes.  Enough to compile the library and
+ * drive it from a simulated modem; not a general purpose Arduino emulation.
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "Print.h"
+#include "Stream.h"
+#include "WString.h"
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+inline unsigned long millis() {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+inline unsigned long micros() {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+inline void yield() {}
+
+inline void delay(unsigned long ms) {
+  if (ms) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// GPIO is not simulated; the pin calls used for modem power/reset lines are
+// accepted and ignored.
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int  digitalRead(uint8_t) {
+  return LOW;
+}
+
+inline bool isDigit(int c) {
+  return c >= '0' && c <= '9';
+}
+
+#endif  // HOST_ARDUINO_H_
@@ -0,0 +1,17 @@
+/**
+ * @file       Client.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Host stand-in for the Arduino Client class; reuses the library's own copy.
+ */
+
+#ifndef HOST_CLIENT_H_
+#define HOST_CLIENT_H_
+
+#include "Arduino.h"
+#include <ArduinoCompat/Client.h>
+
+#endif  // HOST_CLIENT_H_
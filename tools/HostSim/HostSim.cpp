@@ -0,0 +1,719 @@
+/**
+ * @file       HostSim.cpp
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Runs the library on a Linux host against ModemSimulator: checks that a
+ * socket carries data both ways unchanged and measures how fast
+ * waitResponse(), modemSend() and modemRead() get through it.  There is no
+ * serial line in between, so the figures are the library's own overhead.
+ *
+ * Build it for one modem at a time, from the root of the library:
+ *
+ *   g++ -std=gnu++11 -O2 -Itools/HostSim -Isrc -DTINY_GSM_MODEM_SIM800 \
+ *       tools/HostSim/HostSim.cpp -o hostsim && ./hostsim
+ *
+ * with TINY_GSM_MODEM_SIM800, _BG96, _SIM7600, _UBLOX or _ESP8266.  Add
+ * -DTINY_GSM_TX_COALESCE to see small writes gathered into one send.  The
+ * receive FIFO is the library's default (TINY_GSM_RX_BUFFER); run again with
+ * -DTINY_GSM_RX_BUFFER=1500 as well, as the reads are sized differently
+ * once a whole piece fits, and with -DTINY_GSM_RX_POOL=2048 to have the
+ * clients share one receive pool.
+ * The exit code is non-zero if any of the checks fail.
+ */
+
+#if defined(TINY_GSM_MODEM_SIM800)
+#define SIM_DIALECT ModemSimulator::SIM800
+#elif defined(TINY_GSM_MODEM_BG96)
+#define SIM_DIALECT ModemSimulator::BG96
+#elif defined(TINY_GSM_MODEM_SIM7600)
+#define SIM_DIALECT ModemSimulator::SIM7600
+#elif defined(TINY_GSM_MODEM_UBLOX)
+#define SIM_DIALECT ModemSimulator::UBLOX
+#elif defined(TINY_GSM_MODEM_ESP8266)
+#define SIM_DIALECT ModemSimulator::ESP8266
+#define SIM_SIGNAL_QUERY "+CWJAP?"
+#define SIM_SIGNAL_REPLY \
+  "+CWJAP:\"ssid\",\"aa:bb:cc:dd:ee:ff\",6,-58\r\n\r\nOK\r\n"
+#define SIM_SIGNAL -58
+#else
+#error Please define one of the simulated modems
+#endif
+
+#if !defined(SIM_SIGNAL_QUERY)
+#define SIM_SIGNAL_QUERY "+CSQ"
+#define SIM_SIGNAL_REPLY "\r\n+CSQ: 21,0\r\n\r\nOK\r\n"
+#define SIM_SIGNAL 21
+#endif
+
+// The ESP8266 pushes each +IPD (one TCP segment) whole, so its FIFO has to
+// be big enough to take one; the others run with the library's default
+// unless it is given on the command line
+#if defined(TINY_GSM_MODEM_ESP8266) && !defined(TINY_GSM_RX_BUFFER)
+#define TINY_GSM_RX_BUFFER 1500
+#endif
+
+// The queued AT commands are opt-in, and checked here
+#define TINY_GSM_ASYNC
+
+#include "ModemSimulator.h"
+
+#include <TinyGsmClient.h>
+#include <TinyGsmCmux.h>
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t COMMANDS = 20000;
+static const uint32_t TOTAL    = 64L * 1024L;
+static const uint16_t CHUNK    = 1024;
+static const uint16_t SMALL    = 64;
+static int            failures = 0;
+
+static uint8_t pattern(uint32_t i) {
+  return static_cast<uint8_t>((i * 7) ^ (i >> 8));
+}
+
+// Plays back a block of memory, as a file on an SD card would.  It can claim
+// to have more than it does, as a stream that fails part way might.
+class ArrayStream : public Stream {
+ public:
+  ArrayStream(const uint8_t* data, size_t len, size_t overstate = 0)
+      : _data(data), _len(len), _pos(0), _over(overstate) {}
+
+  int available() override {
+    return static_cast<int>(_len - _pos + _over);
+  }
+  int read() override {
+    return _pos < _len ? _data[_pos++] : -1;
+  }
+  int peek() override {
+    return _pos < _len ? _data[_pos] : -1;
+  }
+  size_t write(uint8_t) override {
+    return 0;
+  }
+
+ private:
+  const uint8_t* _data;
+  size_t         _len;
+  size_t         _pos;
+  size_t         _over;
+};
+
+// Takes up to a limited number of characters, checking they are the ones
+// expected, as a file filling up would.  It can say how much room it has
+// left, as some files do, or not, as most sinks don't.
+class CheckSink : public Print {
+ public:
+  CheckSink(uint32_t first, uint32_t limit, bool tells = false)
+      : count(0), ok(true), _next(first), _limit(limit), _tells(tells) {}
+
+  int availableForWrite() override {
+    return _tells ? static_cast<int>(_limit - count) : 0;
+  }
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+  size_t write(const uint8_t* buf, size_t len) override {
+    if (len > _limit - count) { len = _limit - count; }
+    for (size_t i = 0; i < len; i++) { ok &= buf[i] == pattern(_next++); }
+    count += len;
+    return len;
+  }
+
+  uint32_t count;
+  bool     ok;
+
+ private:
+  uint32_t _next;
+  uint32_t _limit;
+  bool     _tells;
+};
+
+class FarEnd;
+
+// One end of a serial line, the other end of which is another Wire.  The
+// far end (if given) gets to answer once everything it sent has been read.
+class Wire : public Stream {
+ public:
+  Wire(std::string& in, std::string& out)
+      : far(NULL), _in(in), _out(out), _pos(0) {}
+
+  int available() override;
+  int read() override {
+    if (_pos >= _in.size()) { return -1; }
+    uint8_t c = _in[_pos++];
+    if (_pos == _in.size()) {
+      _in.clear();
+      _pos = 0;
+    }
+    return c;
+  }
+  int peek() override {
+    return _pos < _in.size() ? static_cast<uint8_t>(_in[_pos]) : -1;
+  }
+  size_t write(uint8_t c) override {
+    _out += static_cast<char>(c);
+    return 1;
+  }
+  using Print::write;
+
+  FarEnd* far;
+
+ private:
+  std::string& _in;
+  std::string& _out;
+  size_t       _pos;
+};
+
+// The modem's side of a multiplexed line: its channel 1 goes to a
+// simulator, a frame at a time while the host lets it, and channel 2 is left
+// for the test to write NMEA to
+class FarEnd {
+ public:
+  FarEnd(Wire& wire, ModemSimulator& sim) : cmux(wire), _sim(sim) {}
+
+  void pump() {
+    TinyGsmCmux::Channel& at = cmux.channel(1);
+    while (at.available()) { _sim.write(at.read()); }
+    for (int n = at.availableForWrite(); n > 0 && _sim.available(); n--) {
+      at.write(_sim.read());
+    }
+    at.flush();
+  }
+
+  TinyGsmCmux cmux;
+
+ private:
+  ModemSimulator& _sim;
+};
+
+int Wire::available() {
+  if (far && _pos == _in.size()) { far->pump(); }
+  return static_cast<int>(_in.size() - _pos);
+}
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+#if defined(TINY_GSM_MODEM_HAS_ASYNC)
+// Which queued commands have finished so far, and with what result
+static uint8_t asyncIds[8];
+static int8_t  asyncResults[8];
+static uint8_t asyncDone = 0;
+
+static void asyncFinished(int8_t result, void* context) {
+  if (asyncDone >= sizeof(asyncIds)) { return; }
+  asyncIds[asyncDone]     = *static_cast<uint8_t*>(context);
+  asyncResults[asyncDone] = result;
+  asyncDone++;
+}
+#endif
+
+static void report(const char* what, uint32_t count, const char* unit,
+                   unsigned long us) {
+  if (!us) { us = 1; }
+  printf("%-14s %8lu %-8s %8lu us %12.0f %s/s\n", what,
+         static_cast<unsigned long>(count), unit, us,
+         count * 1000000.0 / us, unit);
+}
+
+int main() {
+  ModemSimulator sim(SIM_DIALECT);
+  TinyGsm        modem(sim);
+  TinyGsmClient  client(modem);
+
+  check(modem.begin(), "begin()");
+
+  // Response parsing: a query whose answer has to be picked out of the reply
+  sim.on(SIM_SIGNAL_QUERY, SIM_SIGNAL_REPLY);
+  unsigned long start = micros();
+  bool          ok    = true;
+  for (uint32_t i = 0; i < COMMANDS; i++) {
+    ok &= (modem.getSignalQuality() == SIM_SIGNAL);
+  }
+  report("waitResponse", COMMANDS, "commands", micros() - start);
+  check(ok, "getSignalQuality()");
+
+  check(client.connect("example.com", 80), "connect()");
+  int8_t mux = sim.lastOpened();
+  check(mux >= 0, "socket opened");
+  if (mux < 0) { return 1; }
+
+#if defined(TINY_GSM_MODEM_HAS_DNS)
+  // The host connect() looked up is not looked up again, whatever the case
+  uint32_t lookups = sim.lookupCount();
+  check(lookups == 1, "connect() looked the host up");
+  check(modem.resolve("Example.COM") == IPAddress(10, 0, 0, 1) &&
+            sim.lookupCount() == lookups,
+        "resolve() from the cache");
+  modem.clearDnsCache();
+  check(modem.resolve("example.com") == IPAddress(10, 0, 0, 1) &&
+            sim.lookupCount() == ++lookups,
+        "resolve() after clearDnsCache()");
+  static const char* const hosts[] = {"a.example.com", "b.example.com",
+                                      "c.example.com", "d.example.com"};
+  check(modem.prefetch(hosts, 3) == 3 && sim.lookupCount() == lookups + 3,
+        "prefetch()");
+  // With the cache full, the host used longest ago makes room
+  modem.resolve("example.com");
+  modem.resolve(hosts[3]);
+  lookups = sim.lookupCount();
+  modem.resolve("example.com");
+  modem.resolve(hosts[1]);
+  check(sim.lookupCount() == lookups, "recently used hosts kept");
+  modem.resolve(hosts[0]);
+  check(sim.lookupCount() == lookups + 1, "least recently used host dropped");
+#endif
+
+  // Sending, all in one write that has to be split up for the modem
+  static uint8_t all[TOTAL];
+  for (uint32_t i = 0; i < TOTAL; i++) { all[i] = pattern(i); }
+  start = micros();
+  check(client.write(all, TOTAL) == TOTAL, "write()");
+  client.flush();
+  report("modemSend", TOTAL, "bytes", micros() - start);
+  const std::string& out = sim.sent(mux);
+  ok                     = out.size() == TOTAL;
+  for (uint32_t i = 0; ok && i < TOTAL; i++) {
+    ok = static_cast<uint8_t>(out[i]) == pattern(i);
+  }
+  check(ok, "data sent unchanged");
+  sim.clearSent(mux);
+
+  // Sending straight from another stream and from flash
+  ArrayStream file(all, TOTAL / 2);
+  check(client.writeFrom(file, TOTAL / 2) == TOTAL / 2, "writeFrom(Stream)");
+  check(client.writeFrom(all + TOTAL / 2, TOTAL / 2) == TOTAL / 2,
+        "writeFrom(flash)");
+  ok = out.size() == TOTAL;
+  for (uint32_t i = 0; ok && i < TOTAL; i++) {
+    ok = static_cast<uint8_t>(out[i]) == pattern(i);
+  }
+  check(ok, "writeFrom() sent unchanged");
+  sim.clearSent(mux);
+  ArrayStream failing(all, SMALL, SMALL);
+  failing.setTimeout(10);
+  check(client.writeFrom(failing, 2 * SMALL) == SMALL,
+        "writeFrom() counts only what the stream gave");
+  sim.clearSent(mux);
+
+  // Sending a character at a time, as print() often does
+  uint32_t commands = sim.commandCount();
+  start             = micros();
+  for (uint16_t i = 0; i < SMALL; i++) { client.write(pattern(i)); }
+  client.flush();
+  report("small writes", SMALL, "bytes", micros() - start);
+  printf("%-14s %8lu commands\n", "",
+         static_cast<unsigned long>(sim.commandCount() - commands));
+  ok = out.size() == SMALL;
+  for (uint32_t i = 0; ok && i < SMALL; i++) {
+    ok = static_cast<uint8_t>(out[i]) == pattern(i);
+  }
+  check(ok, "small writes sent unchanged");
+  sim.clearSent(mux);
+
+  // Receiving, in pieces the size a modem would announce at once.  Only the
+  // reads are timed: taking in each announcement (or from the ESP8266, the
+  // data itself) costs maintain() a wait for anything following it, which is
+  // the same however the data is read.
+  uint8_t  buf[CHUNK];
+  uint32_t got     = 0;
+  uint32_t offered = 0;
+  uint32_t spent   = 0;
+  ok               = true;
+  while (got < TOTAL) {
+    if (offered == got) {
+      for (uint16_t i = 0; i < CHUNK; i++) { buf[i] = pattern(offered + i); }
+      sim.receive(mux, buf, CHUNK);
+      offered += CHUNK;
+      modem.maintain();  // Takes in the URC
+    }
+    uint8_t in[CHUNK];
+    start = micros();
+    int n = client.read(in, sizeof(in));
+    spent += micros() - start;
+    if (n <= 0) {
+      if (!client.available()) {
+        check(false, "read() stalled");
+        break;
+      }
+      continue;
+    }
+    for (int i = 0; ok && i < n; i++) { ok = in[i] == pattern(got + i); }
+    got += n;
+  }
+  report("modemRead", got, "bytes", spent);
+  check(ok && got == TOTAL, "data received unchanged");
+
+  // Receiving straight into a sink, which fills up a piece short of the end
+  // without warning, and then into one that says how much it takes; none of
+  // what the first refuses may be lost.  The last piece has to fit in the
+  // FIFO as the ESP8266 pushes it anyway.
+  const uint32_t SINK = TOTAL / 2;
+  for (offered = 0; offered < SINK + CHUNK; offered += CHUNK) {
+    for (uint16_t i = 0; i < CHUNK; i++) { buf[i] = pattern(offered + i); }
+    sim.receive(mux, buf, CHUNK);
+  }
+  CheckSink full(0, SINK);
+  CheckSink rest(SINK, CHUNK, true);
+  start = micros();
+  check(client.readTo(full, TOTAL, 1000) == SINK, "readTo() full sink");
+  check(client.readTo(rest, CHUNK, 1000) == CHUNK, "readTo() the rest");
+  report("readTo", full.count + rest.count, "bytes", micros() - start);
+  check(full.ok && rest.ok, "readTo() data unchanged");
+
+#if defined TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+  // A reply whose URC never comes, found by polling; right after a request
+  // the modem is asked soon
+  client.write(reinterpret_cast<const uint8_t*>("ping"), 4);
+  client.flush();
+  sim.receiveQuietly(mux, "pong");
+  start = micros();
+  while (!client.available() && micros() - start < 2000000UL) {}
+  report("missed URC", 1, "replies", micros() - start);
+  check(client.available() == 4 && micros() - start < 500000UL,
+        "reply without a URC found quickly");
+  for (got = 0; got < 4 && client.available();) {
+    got += client.read(buf, 4 - got);
+  }
+  sim.clearSent(mux);
+#endif
+
+  // Refreshing the status of several sockets at once, each flagged by a URC
+  // but with nothing left to read
+  const uint8_t SOCKS = 4;
+  TinyGsmClient more1(modem, 1);
+  TinyGsmClient more2(modem, 2);
+  TinyGsmClient more3(modem, 3);
+  TinyGsmClient* socks[SOCKS] = {&client, &more1, &more2, &more3};
+  int8_t         muxes[SOCKS] = {mux};
+#if defined(TINY_GSM_MODEM_HAS_CONNECT_ASYNC)
+  // Opened all at once, then waited on together; a host that is not cached
+  // goes to the modem by name, as waiting on a lookup would block
+  uint32_t named = sim.lookupCount();
+  start          = micros();
+  for (uint8_t i = 1; i < SOCKS; i++) {
+    check(socks[i]->connectAsync(i == 1 ? "new.example.com" : "example.com",
+                                 80),
+          "connectAsync()");
+    muxes[i] = sim.lastOpened();
+  }
+  check(sim.lookupCount() == named, "connectAsync() makes no lookup");
+  while (more1.connecting() || more2.connecting() || more3.connecting()) {}
+  report("connectAsync", SOCKS - 1, "sockets", micros() - start);
+  ok = true;
+  for (uint8_t i = 1; i < SOCKS; i++) { ok &= socks[i]->connected() != 0; }
+  check(ok, "connectAsync() sockets connected");
+#else
+  for (uint8_t i = 1; i < SOCKS; i++) {
+    check(socks[i]->connect("example.com", 80), "connect() more sockets");
+    muxes[i] = sim.lastOpened();
+  }
+#endif
+  for (uint8_t i = 0; i < SOCKS; i++) { sim.announce(muxes[i]); }
+  modem.maintain();  // Takes in the URC's
+  commands = sim.commandCount();
+  start    = micros();
+  modem.maintain();
+  report("status refresh", SOCKS, "sockets", micros() - start);
+  printf("%-14s %8lu commands\n", "",
+         static_cast<unsigned long>(sim.commandCount() - commands));
+#if defined TINY_GSM_BUFFER_READ_AND_CHECK_SIZE
+  ok = true;
+  for (uint8_t i = 0; i < SOCKS; i++) { ok &= socks[i]->connected() != 0; }
+  check(ok, "sockets still connected after refresh");
+#endif
+  for (uint8_t i = 1; i < SOCKS; i++) { socks[i]->stop(); }
+
+#if defined(TINY_GSM_MODEM_HAS_CONNECT_ASYNC) && \
+    defined(TINY_GSM_MODEM_HAS_DNS)
+  // A connectAsync() that fails forgets the cached address, as connect()
+  // does, in case the host has moved
+  modem.resolve("example.com");
+  named = sim.lookupCount();
+  sim.refuse(true);
+  check(more1.connectAsync("example.com", 80), "refused connectAsync()");
+  while (more1.connecting()) {}
+  sim.refuse(false);
+  check(!more1.connected(), "refused connectAsync() not connected");
+  modem.resolve("example.com");
+  check(sim.lookupCount() == named + 1, "refused address dropped");
+#endif
+
+  // A socket made over memory that held something else, which is not ready
+  // until the modem says so; the drivers with no buffer on the modem side
+  // never set the count of what is waiting there
+  alignas(TinyGsmClient) static uint8_t reused[sizeof(TinyGsmClient)];
+  memset(reused, 0xFF, sizeof(reused));
+  TinyGsmClient* fresh = new (reused) TinyGsmClient(modem, muxes[1]);
+  check(!modem.pollSockets(1UL << muxes[1]), "pollSockets() on an idle socket");
+  check(fresh->connect("example.com", 80), "connect() over reused memory");
+  uint32_t freshBit = 1UL << sim.lastOpened();
+  check(!modem.pollSockets(freshBit), "pollSockets() on a fresh socket");
+  fresh->stop();
+  more1.init(&modem, muxes[1]);  // Takes the mux back
+
+  // The modem-wide readiness check, for data and then for the far end
+  // hanging up
+  sim.receive(mux, buf, CHUNK);
+  uint32_t bit = 1UL << mux;
+  check(modem.pollSockets(bit, 1000) == bit, "pollSockets() sees data");
+  check(modem.nextReadySocket(0, bit) == mux, "nextReadySocket()");
+  for (got = 0; got < CHUNK && client.available();) {
+    got += client.read(buf, CHUNK - got);
+  }
+  check(got == CHUNK && !modem.pollSockets(bit), "pollSockets() after reading");
+  sim.remoteClose(mux);
+  check(modem.pollSockets(bit, 2000) == bit, "pollSockets() sees close");
+  uint32_t wait = millis();
+  while (client.connected() && millis() - wait < 2000) {}
+  check(!client.connected(), "remote close seen");
+
+#if defined(TINY_GSM_MODEM_HAS_UDP)
+  // A datagram each way, with no connection set up or torn down around them
+  TinyGsmClientUDP udp(modem, 4);
+  check(udp.begin(5000), "UDP begin()");
+  commands = sim.commandCount();
+  start    = micros();
+  udp.beginPacket("10.0.0.2", 5000);
+  udp.write(reinterpret_cast<const uint8_t*>("ping"), 4);
+  check(udp.endPacket(), "endPacket()");
+  report("datagram", 1, "sent", micros() - start);
+  printf("%-14s %8lu commands\n", "",
+         static_cast<unsigned long>(sim.commandCount() - commands));
+  int8_t udpMux = sim.lastOpened();
+  check(udpMux >= 0 && sim.sent(udpMux) == "ping", "datagram sent");
+#if defined(TINY_GSM_MODEM_BG96) || defined(TINY_GSM_MODEM_UBLOX)
+  // These only send to an address, so a name is looked up first
+  udp.beginPacket("example.com", 5000);
+  udp.write(reinterpret_cast<const uint8_t*>("ping"), 4);
+  check(udp.endPacket() &&
+            sim.lastCommand().find("\"10.0.0.1\"") != std::string::npos,
+        "datagram sent to a name");
+#endif
+  sim.receiveDatagram(udpMux, "one");
+  sim.receiveDatagram(udpMux, "three");
+  wait = millis();
+  while (!udp.parsePacket() && millis() - wait < 2000) {}
+  check(udp.available() == 3 && udp.read(buf, CHUNK) == 3 &&
+            memcmp(buf, "one", 3) == 0,
+        "first datagram alone");
+  check(udp.remoteIP() == IPAddress(10, 0, 0, 2) && udp.remotePort() == 5000,
+        "datagram sender");
+  check(udp.parsePacket() == 5 && udp.read() == 't', "second datagram");
+  check(udp.parsePacket() == 0, "datagram rest dropped");
+  udp.stop();
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_TRANSPARENT)
+  // Bulk data over a socket in data mode, with no commands around it
+  TinyGsmClientTransparent direct(modem, 5);
+  check(direct.connect("10.0.0.1", 80) && sim.inDataMode(),
+        "transparent connect()");
+  int8_t dataMux = sim.lastOpened();
+  std::string bulk;
+  for (size_t i = 0; i < 16 * CHUNK; i++) { bulk += static_cast<char>(i); }
+  commands = sim.commandCount();
+  start    = micros();
+  for (size_t i = 0; i < bulk.size(); i += CHUNK) {
+    direct.write(reinterpret_cast<const uint8_t*>(bulk.data() + i), CHUNK);
+  }
+  report("data mode", bulk.size(), "bytes", micros() - start);
+  printf("%-14s %8lu commands\n", "",
+         static_cast<unsigned long>(sim.commandCount() - commands));
+  check(sim.sent(dataMux) == bulk, "data mode sent");
+  sim.receive(dataMux, "hello");
+  check(direct.available() == 5 && direct.read(buf, CHUNK) == 5 &&
+            memcmp(buf, "hello", 5) == 0,
+        "data mode read");
+  // Out to command mode and back, with data arriving in between
+  check(direct.commandMode() && !sim.inDataMode(), "commandMode()");
+  check(modem.testAT(100), "AT after commandMode()");
+  sim.receive(dataMux, "later");
+  for (got = 0, wait = millis(); got < 5 && millis() - wait < 2000;) {
+    got += direct.read(buf + got, 5 - got);
+  }
+  check(got == 5 && memcmp(buf, "later", 5) == 0 && sim.inDataMode(),
+        "back to data mode");
+  sim.remoteClose(dataMux);
+  wait = millis();
+  while (direct.connected() && millis() - wait < 2000) { direct.read(); }
+  check(!direct.connected() && modem.testAT(100), "data mode close seen");
+  direct.stop();
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_CMUX)
+  // A socket and a stream of NMEA sentences sharing one line through the
+  // multiplexer, with the far end sorting the frames out the same way
+  std::string    toModem, toHost;
+  Wire           hostWire(toHost, toModem);
+  Wire           farWire(toModem, toHost);
+  ModemSimulator farSim(SIM_DIALECT);
+  FarEnd         far(farWire, farSim);
+  hostWire.far = &far;
+  TinyGsmCmux cmux(hostWire);
+  toHost += "\r\nOK\r\n";  // To the AT+CMUX
+  check(cmux.begin(), "CMUX begin()");
+  TinyGsm       muxModem(cmux.channel(1));
+  TinyGsmClient muxClient(muxModem);
+  check(muxModem.testAT(100), "AT over CMUX");
+  check(muxClient.connect("10.0.0.1", 80), "connect() over CMUX");
+  int8_t muxMux = farSim.lastOpened();
+  for (uint16_t i = 0; i < CHUNK; i++) { buf[i] = pattern(i); }
+  farSim.receive(muxMux, buf, CHUNK);
+  const char* nmea = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,"
+                     "46.9,M,,*47\r\n";
+  far.cmux.channel(2).print(nmea);
+  far.cmux.channel(2).flush();
+  start = micros();
+  memset(buf, 0, CHUNK);
+  for (got = 0, wait = millis(); got < CHUNK && millis() - wait < 2000;) {
+    got += muxClient.read(buf + got, CHUNK - got);
+  }
+  report("CMUX read", got, "bytes", micros() - start);
+  ok = got == CHUNK;
+  for (uint16_t i = 0; i < got; i++) { ok &= buf[i] == pattern(i); }
+  check(ok, "socket data over CMUX");
+  check(cmux.channel(2).readString() == nmea, "NMEA over CMUX");
+  // Flushed, as with TINY_GSM_TX_COALESCE the write is only gathered
+  bool wrote = muxClient.write(buf, SMALL) == SMALL;
+  muxClient.flush();
+  check(wrote && farSim.sent(muxMux) == std::string(buf, buf + SMALL),
+        "socket write over CMUX");
+  check(!cmux.errors() && !far.cmux.errors(), "no CMUX frames dropped");
+  // A channel left unread fills up and is stopped, without holding up the
+  // others; what it kept is what came first
+  std::string flood;
+  while (flood.size() < 4 * TINY_GSM_CMUX_BUFFER) { flood += nmea; }
+  far.cmux.channel(2).print(flood.c_str());
+  far.cmux.channel(2).flush();
+  check(muxModem.testAT(100), "AT over CMUX with a full channel");
+  check(cmux.errors() > 0, "full channel's frames dropped");
+  std::string kept = cmux.channel(2).readString().c_str();
+  check(!kept.empty() && flood.compare(0, kept.size(), kept) == 0,
+        "full channel keeps the first frames");
+  muxClient.stop();
+  cmux.end();
+#endif
+
+#if defined(TINY_GSM_RX_POOL)
+  // Several clients sharing the receive pool.  Those holding data they have
+  // not read can use it all up between them; another client then still reads
+  // straight into its own buffer and stops without waiting on what is left
+  // in the modem, and each stop() hands its chunks back.
+  typedef TinyGsmPool<TINY_GSM_RX_POOL_CHUNK,
+                      TINY_GSM_RX_POOL / TINY_GSM_RX_POOL_CHUNK>
+                RxPool;
+  RxPool&       pool   = RxPool::instance();
+  const uint8_t chunks = TINY_GSM_RX_POOL / TINY_GSM_RX_POOL_CHUNK;
+  check(pool.available() == chunks, "RX pool free");
+  check(client.connect("example.com", 80), "connect() pooled client");
+  int8_t poolMux = sim.lastOpened();
+  for (uint8_t i = 1; i < SOCKS; i++) {
+    check(socks[i]->connect("example.com", 80), "connect() pooled clients");
+    muxes[i] = sim.lastOpened();
+    for (offered = 0; offered < TINY_GSM_RX_POOL; offered += CHUNK) {
+      for (uint16_t j = 0; j < CHUNK; j++) { buf[j] = pattern(offered + j); }
+      sim.receive(muxes[i], buf, CHUNK);
+    }
+  }
+  ok = true;
+#if defined TINY_GSM_NO_MODEM_BUFFER
+  modem.maintain();  // Takes in all of it, losing what does not fit
+#else
+  for (uint8_t i = 1; i < SOCKS; i++) {
+    // Brings in as much as one read from the modem can
+    uint8_t first = 0;
+    ok &= socks[i]->read(&first, 1) == 1 && first == pattern(0);
+  }
+#endif
+  check(ok && pool.available() == 0, "RX pool used up");
+
+  uint8_t small[SMALL];
+  for (uint16_t i = 0; i < SMALL; i++) { small[i] = pattern(i); }
+  sim.receive(poolMux, small, SMALL);
+  sim.receive(poolMux, small, SMALL);  // Left in the modem
+  memset(small, 0, SMALL);
+  for (got = 0, wait = millis(); got < SMALL && millis() - wait < 2000;) {
+    got += client.read(small + got, SMALL - got);
+  }
+  ok = got == SMALL;
+  for (uint16_t i = 0; ok && i < SMALL; i++) { ok = small[i] == pattern(i); }
+  check(ok, "read() with the RX pool used up");
+  wait = millis();
+  client.stop();
+  check(millis() - wait < 1000, "stop() with the RX pool used up");
+
+#if !defined TINY_GSM_NO_MODEM_BUFFER
+  // What did not fit waited in the modem
+  ok = true;
+  for (got = 1, wait = millis();
+       got < TINY_GSM_RX_POOL && millis() - wait < 2000;) {
+    int n = more1.read(buf, CHUNK);
+    for (int i = 0; ok && i < n; i++) { ok = buf[i] == pattern(got + i); }
+    if (n > 0) { got += n; }
+  }
+  check(ok && got == TINY_GSM_RX_POOL, "pooled data unchanged");
+#endif
+  for (uint8_t i = 1; i < SOCKS; i++) { socks[i]->stop(); }
+  check(pool.available() == chunks, "stop() gives the RX pool back");
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_ASYNC)
+  // Queued commands, sent one at a time by poll() and finished in order: one
+  // whose reply only comes after a URC has been handled, one that fails, one
+  // that times out and one answered at once.  The queue refuses a fifth.
+  check(client.connect("example.com", 80), "connect() for queued commands");
+  int8_t asyncMux = sim.lastOpened();
+  sim.on("+ASYNC1", "");
+  sim.on("+ASYNC2", "\r\nERROR\r\n");
+  sim.on("+ASYNC3", "");
+  static uint8_t ids[4] = {1, 2, 3, 4};
+  ok = modem.queueAT(F("+ASYNC1"), asyncFinished, &ids[0]) &&
+       modem.queueAT("+ASYNC2", asyncFinished, &ids[1]) &&
+       modem.queueAT("+ASYNC3", asyncFinished, &ids[2], 20) &&
+       modem.queueAT("+ASYNC4", asyncFinished, &ids[3]);
+  check(ok && !modem.queueAT("+ASYNC5") && modem.pendingAT() == 4,
+        "queueAT() until the queue is full");
+  check(modem.poll() && sim.lastCommand() == "+ASYNC1" && !asyncDone,
+        "first queued command sent");
+  sim.remoteClose(asyncMux);
+  modem.poll();
+  check(!asyncDone && modem.pollSockets(1UL << asyncMux) == 1UL << asyncMux,
+        "URC handled while a queued command waits");
+  sim.inject("\r\nOK\r\n");
+  for (wait = millis(); modem.poll() && millis() - wait < 1000;) {}
+  ok = asyncDone == 4 && !modem.pendingAT();
+  for (uint8_t i = 0; ok && i < 4; i++) { ok = asyncIds[i] == i + 1; }
+  check(ok, "queued commands finished in order");
+  check(asyncResults[0] == 1 && asyncResults[1] == 2 && asyncResults[2] == 0 &&
+            asyncResults[3] == 1,
+        "queued command results");
+
+  // One finished by an intermediate line leaves its OK to be skipped, not
+  // taken as the answer to the next one
+  sim.on("+ASYNC6", "\r\n+ASYNC6: 1\r\n\r\nOK\r\n");
+  sim.on("+ASYNC7", "\r\nERROR\r\n");
+  ok = modem.queueAT("+ASYNC6", asyncFinished, &ids[0], 1000L,
+                     GFP("+ASYNC6:")) &&
+       modem.queueAT("+ASYNC7", asyncFinished, &ids[1]);
+  for (wait = millis(); modem.poll() && millis() - wait < 1000;) {}
+  check(ok && asyncDone == 6 && asyncResults[4] == 1 && asyncResults[5] == 2,
+        "intermediate response skips the OK");
+  client.stop();
+#endif
+
+  printf("%lu commands, %s\n", static_cast<unsigned long>(sim.commandCount()),
+         failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
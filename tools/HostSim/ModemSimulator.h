@@ -0,0 +1,751 @@
+/**
+ * @file       ModemSimulator.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * A scriptable stand-in for a modem, seen by the library as the Stream it
+ * talks to.  Commands written to it are answered at once in the dialect of
+ * one of the supported modems, with sockets that keep their own receive
+ * buffers the way the real modules do.  Tests can add replies of their own,
+ * inject URC's, and push payload into a socket as if it had come from the
+ * network.
+ *
+ * Covers the commands used by begin(), the TCP client and the socket status
+ * checks of the SIM800, BG96, SIM7600, u-blox (SARA-U2/LISA) and ESP8266
+ * drivers, the UDP sockets of the SIM800, BG96 and u-blox ones, the
+ * transparent (data) mode of the BG96 and u-blox ones, and the host name
+ * lookups of all but the ESP8266, which find every host at 10.0.0.1.
+ * Anything else is answered with "OK".
+ */
+
+#ifndef HOST_MODEMSIMULATOR_H_
+#define HOST_MODEMSIMULATOR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+
+class ModemSimulator : public Stream {
+ public:
+  enum Dialect { SIM800, BG96, SIM7600, UBLOX, ESP8266 };
+
+  static const uint8_t MUX_COUNT = 12;
+
+  explicit ModemSimulator(Dialect dialect)
+      : _dialect(dialect),
+        _outPos(0),
+        _sendMux(0),
+        _sendLen(-1),
+        _sendTo(false),
+        _skipLf(false),
+        _commands(0),
+        _lookups(0),
+        _refuse(false),
+        _lastOpened(-1),
+        _dataMux(-1),
+        _plus(0),
+        _lastData(0) {}
+
+  /*
+   * Scripting
+   */
+  // Answers any command starting with cmd (given without the "AT") with
+  // reply, in place of the built-in behaviour.  The latest rule added wins.
+  void on(const char* cmd, const char* reply) {
+    _rules.push_back(std::make_pair(std::string(cmd), std::string(reply)));
+  }
+
+  // Sends text as if the modem had come up with it unprompted (ie, a URC)
+  void inject(const char* text) {
+    _out += text;
+  }
+
+  // Data arriving on a socket from the network.  It is held in the socket's
+  // buffer in the modem and announced with the dialect's URC; the ESP8266
+  // has no buffer and pushes it out straight away.
+  void receive(uint8_t mux, const uint8_t* data, size_t len) {
+    if (mux >= MUX_COUNT || !len) { return; }
+    if (mux == _dataMux) {
+      _out.append(reinterpret_cast<const char*>(data), len);
+      return;
+    }
+    if (_dialect == ESP8266) {
+      char urc[48];
+      snprintf(urc, sizeof(urc), "\r\n+IPD,%u,%u:", mux,
+               static_cast<unsigned>(len));
+      _out += urc;
+      _out.append(reinterpret_cast<const char*>(data), len);
+      return;
+    }
+    _sockets[mux].rx.append(reinterpret_cast<const char*>(data), len);
+    announce(mux);
+  }
+  void receive(uint8_t mux, const char* text) {
+    receive(mux, reinterpret_cast<const uint8_t*>(text), strlen(text));
+  }
+
+  // A datagram arriving on a UDP socket, from 10.0.0.2 port 5000.  Reads stop
+  // at the end of it.
+  void receiveDatagram(uint8_t mux, const char* text) {
+    if (mux >= MUX_COUNT || !_sockets[mux].udp) { return; }
+    _sockets[mux].datagrams.push_back(strlen(text));
+    receive(mux, text);
+  }
+
+  // Data arriving on a socket without the URC, as from a modem that forgets
+  // to send it
+  void receiveQuietly(uint8_t mux, const char* text) {
+    if (mux >= MUX_COUNT || _dialect == ESP8266) { return; }
+    _sockets[mux].rx.append(text);
+  }
+
+  // Sends the URC for data arriving on a socket, whether there is any or not;
+  // a real modem can do that when the URC crosses with a read that already
+  // took the data
+  void announce(uint8_t mux) {
+    if (mux >= MUX_COUNT) { return; }
+    char urc[48];
+    switch (_dialect) {
+      case SIM800:
+      case SIM7600:
+        snprintf(urc, sizeof(urc), "\r\n+CIPRXGET: 1,%u\r\n", mux);
+        break;
+      case BG96:
+        snprintf(urc, sizeof(urc), "\r\n+QIURC: \"recv\",%u\r\n", mux);
+        break;
+      case UBLOX:
+        snprintf(urc, sizeof(urc), "\r\n+UUSOR%c: %u,%u\r\n",
+                 _sockets[mux].udp ? 'F' : 'D', mux,
+                 static_cast<unsigned>(_sockets[mux].rx.size()));
+        break;
+      case ESP8266: return;
+    }
+    _out += urc;
+  }
+
+  // While set, the far end turns down every connection; the modem takes the
+  // command and then reports the failure as it would for an unreachable host
+  void refuse(bool on) {
+    _refuse = on;
+  }
+
+  // The far end closes a socket
+  void remoteClose(uint8_t mux) {
+    if (mux >= MUX_COUNT) { return; }
+    _sockets[mux].connected = false;
+    if (mux == _dataMux) {
+      // Data mode ends with it, and the modem says so
+      _dataMux = -1;
+      _out += _dialect == UBLOX ? "\r\nDISCONNECT\r\n"
+                                : "\r\nNO CARRIER\r\n";
+      return;
+    }
+    char urc[48];
+    switch (_dialect) {
+      case SIM800:
+        snprintf(urc, sizeof(urc), "\r\n%u, CLOSED\r\n", mux);
+        break;
+      case SIM7600:
+        snprintf(urc, sizeof(urc), "\r\n+IPCLOSE: %u,1\r\n", mux);
+        break;
+      case BG96:
+        snprintf(urc, sizeof(urc), "\r\n+QIURC: \"closed\",%u\r\n", mux);
+        break;
+      case UBLOX: snprintf(urc, sizeof(urc), "\r\n+UUSOCL: %u\r\n", mux); break;
+      case ESP8266: snprintf(urc, sizeof(urc), "%u,CLOSED\r\n", mux); break;
+    }
+    _out += urc;
+  }
+
+  /*
+   * Inspection
+   */
+  // Payload the library has sent on a socket
+  const std::string& sent(uint8_t mux) const {
+    return _sockets[mux].tx;
+  }
+  void clearSent(uint8_t mux) {
+    _sockets[mux].tx.clear();
+  }
+  // Payload still held in the modem, not yet read by the library
+  size_t buffered(uint8_t mux) const {
+    return _sockets[mux].rx.size();
+  }
+  bool connected(uint8_t mux) const {
+    return _sockets[mux].connected;
+  }
+  // The socket most recently opened; the u-blox modems pick it themselves
+  int8_t lastOpened() const {
+    return _lastOpened;
+  }
+  uint32_t commandCount() const {
+    return _commands;
+  }
+  const std::string& lastCommand() const {
+    return _lastCommand;
+  }
+  // How many host names the library has had the modem look up
+  uint32_t lookupCount() const {
+    return _lookups;
+  }
+  // Whether the line is carrying a socket's data rather than commands
+  bool inDataMode() const {
+    return _dataMux >= 0;
+  }
+
+  /*
+   * Stream
+   */
+  int available() override {
+    return static_cast<int>(_out.size() - _outPos);
+  }
+  int read() override {
+    if (_outPos >= _out.size()) { return -1; }
+    uint8_t c = _out[_outPos++];
+    if (_outPos == _out.size()) {
+      _out.clear();
+      _outPos = 0;
+    }
+    return c;
+  }
+  int peek() override {
+    if (_outPos >= _out.size()) { return -1; }
+    return static_cast<uint8_t>(_out[_outPos]);
+  }
+  size_t write(uint8_t c) override {
+    bool skip = _skipLf && c == '\n';
+    _skipLf   = false;
+    if (skip) { return 1; }
+    if (_dataMux >= 0) {
+      dataByte(c);
+      return 1;
+    }
+    if (_sendLen >= 0) {
+      _sendBuf += static_cast<char>(c);
+      if (static_cast<int>(_sendBuf.size()) >= _sendLen) { finishSend(); }
+      return 1;
+    }
+    if (c == '\r') {
+      // The "\n" that follows is dropped, even if the command has switched
+      // over to taking payload
+      _skipLf = true;
+      command(_line);
+      _line.clear();
+    } else if (c != '\n') {
+      _line += static_cast<char>(c);
+    }
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    size_t n = 0;
+    while (n < size) {
+      if (_dataMux >= 0 && !_skipLf && buffer[n] != '+') {
+        // Data goes through in one piece, up to a possible escape
+        const void* plus = memchr(buffer + n, '+', size - n);
+        size_t      end  = plus ? static_cast<const uint8_t*>(plus) - buffer
+                                : size;
+        dataByte(buffer[n]);
+        _sockets[_dataMux].tx.append(
+            reinterpret_cast<const char*>(buffer + n + 1), end - n - 1);
+        n = end;
+        continue;
+      }
+      if (_sendLen >= 0 && !_skipLf) {
+        // Payload goes through in one piece
+        size_t chunk = simMin(size - n, _sendLen - _sendBuf.size());
+        _sendBuf.append(reinterpret_cast<const char*>(buffer + n), chunk);
+        n += chunk;
+        if (static_cast<int>(_sendBuf.size()) >= _sendLen) { finishSend(); }
+        continue;
+      }
+      write(buffer[n++]);
+    }
+    return n;
+  }
+  using Print::write;
+
+ protected:
+  struct Socket {
+    Socket() : connected(false), udp(false), read(0) {}
+    bool                connected;
+    bool                udp;
+    size_t              read;
+    std::string         rx;
+    std::string         tx;
+    std::vector<size_t> datagrams;  // Sizes of those waiting in rx
+  };
+
+  static size_t simMin(size_t a, size_t b) {
+    return a < b ? a : b;
+  }
+
+  // A character written in data mode.  "+++" after a second of quiet goes
+  // back to command mode; any other character is payload.
+  void dataByte(uint8_t c) {
+    Socket& s     = _sockets[_dataMux];
+    bool    quiet = millis() - _lastData >= 900;
+    _lastData     = millis();
+    if (c == '+' && (_plus || quiet)) {
+      if (++_plus == 3) {
+        _plus    = 0;
+        _dataMux = -1;
+        _out += "\r\nOK\r\n";
+      }
+      return;
+    }
+    s.tx.append(_plus, '+');
+    s.tx += static_cast<char>(c);
+    _plus = 0;
+  }
+
+  // Switches the line over to a socket's data, handing out what the modem
+  // already holds for it
+  void enterDataMode(long mux) {
+    Socket& s = _sockets[mux];
+    _out += "\r\nCONNECT\r\n";
+    _out += s.rx;
+    s.read += s.rx.size();
+    s.rx.clear();
+    _dataMux  = static_cast<int8_t>(mux);
+    _plus     = 0;
+    _lastData = millis();
+  }
+
+  // Parses the numbers following "=" in a command, ie "+CIPSEND=1,20"
+  static std::vector<long> args(const std::string& cmd) {
+    std::vector<long> res;
+    size_t            eq = cmd.find('=');
+    if (eq == std::string::npos) { return res; }
+    const char* p = cmd.c_str() + eq + 1;
+    while (*p) {
+      res.push_back(strtol(p, NULL, 10));
+      p = strchr(p, ',');
+      if (!p) { break; }
+      p++;
+    }
+    return res;
+  }
+
+  static bool startsWith(const std::string& s, const char* prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+  }
+
+  void reply(const char* fmt, long a = 0, long b = 0, long c = 0) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), fmt, a, b, c);
+    _out += buf;
+  }
+
+  void command(std::string cmd) {
+    if (startsWith(cmd, "AT")) { cmd.erase(0, 2); }
+    _commands++;
+    _lastCommand = cmd;
+    for (size_t i = _rules.size(); i > 0; i--) {
+      if (startsWith(cmd, _rules[i - 1].first.c_str())) {
+        _out += _rules[i - 1].second;
+        return;
+      }
+    }
+    if (startsWith(cmd, "+CPIN?")) {
+      _out += "\r\n+CPIN: READY\r\n\r\nOK\r\n";
+      return;
+    }
+    if (lookupCommand(cmd) || socketCommand(cmd)) { return; }
+    _out += "\r\nOK\r\n";
+  }
+
+  // The host name lookup of each dialect; returns false for anything else
+  bool lookupCommand(const std::string& cmd) {
+    size_t      quote = cmd.find('"');
+    std::string host  = quote == std::string::npos ? "" : cmd.substr(quote);
+    switch (_dialect) {
+      case SIM800:
+        if (!startsWith(cmd, "+CDNSGIP=")) { return false; }
+        _out += "\r\nOK\r\n\r\n+CDNSGIP: 1," + host + ",\"10.0.0.1\"\r\n";
+        break;
+      case SIM7600:
+        if (!startsWith(cmd, "+CDNSGIP=")) { return false; }
+        _out += "\r\n+CDNSGIP: 1," + host + ",\"10.0.0.1\"\r\n\r\nOK\r\n";
+        break;
+      case BG96:
+        if (!startsWith(cmd, "+QIDNSGIP=")) { return false; }
+        _out += "\r\nOK\r\n\r\n+QIURC: \"dnsgip\",0,2,600\r\n"
+                "\r\n+QIURC: \"dnsgip\",\"10.0.0.1\"\r\n"
+                "\r\n+QIURC: \"dnsgip\",\"10.0.0.9\"\r\n";
+        break;
+      case UBLOX:
+        if (!startsWith(cmd, "+UDNSRN=")) { return false; }
+        _out += "\r\n+UDNSRN: \"10.0.0.1\"\r\n\r\nOK\r\n";
+        break;
+      case ESP8266: return false;
+    }
+    _lookups++;
+    return true;
+  }
+
+  // The socket commands of each dialect; returns false for anything else
+  bool socketCommand(const std::string& cmd) {
+    std::vector<long> a = args(cmd);
+    long mux = a.empty() ? -1 : a[0];
+    switch (_dialect) {
+      case SIM800:
+        if (startsWith(cmd, "+CIPSTART=") && valid(mux) && _refuse) {
+          reply("\r\nOK\r\n\r\n%ld, CONNECT FAIL\r\n", mux);
+        } else if (startsWith(cmd, "+CIPSTART=") && valid(mux)) {
+          open(mux, cmd.find("\"UDP\"") != std::string::npos);
+          reply("\r\nOK\r\n\r\n%ld, CONNECT OK\r\n", mux);
+        } else if (startsWith(cmd, "+CIPSEND=") && valid(mux) &&
+                   a.size() > 1) {
+          startSend(mux, a[1], 1460, "\r\n> ");
+        } else if (startsWith(cmd, "+CIPRXGET=2,") && a.size() > 2 &&
+                   valid(a[1])) {
+          readCipRxGet(a[1], a[2], 1460);
+        } else if (startsWith(cmd, "+CIPRXGET=3,") && a.size() > 2 &&
+                   valid(a[1])) {
+          readCipRxGet(a[1], a[2], 1460, true);
+        } else if (startsWith(cmd, "+CIPRXGET=4,") && a.size() > 1 &&
+                   valid(a[1])) {
+          reply("\r\n+CIPRXGET: 4,%ld,%ld\r\n\r\nOK\r\n", a[1],
+                static_cast<long>(_sockets[a[1]].rx.size()));
+        } else if (startsWith(cmd, "+CIPSTATUS=") && valid(mux)) {
+          reply("\r\n+CIPSTATUS: %ld,0,\"TCP\",\"10.0.0.1\",\"80\",", mux);
+          _out += _sockets[mux].connected ? "\"CONNECTED\"\r\n\r\nOK\r\n"
+                                          : "\"CLOSED\"\r\n\r\nOK\r\n";
+        } else if (cmd == "+CIPSTATUS") {
+          // All six connections are listed, after the OK
+          _out += "\r\nOK\r\n\r\nSTATE: IP PROCESSING\r\n\r\n";
+          for (uint8_t i = 0; i < 6; i++) {
+            char line[64];
+            snprintf(line, sizeof(line),
+                     "C: %u,0,\"TCP\",\"10.0.0.1\",\"80\",\"%s\"\r\n", i,
+                     _sockets[i].connected ? "CONNECTED" : "CLOSED");
+            _out += line;
+          }
+        } else if (startsWith(cmd, "+CIPCLOSE=") && valid(mux)) {
+          _sockets[mux].connected = false;
+          reply("\r\n%ld, CLOSE OK\r\n", mux);
+        } else {
+          return false;
+        }
+        return true;
+
+      case SIM7600:
+        if (startsWith(cmd, "+CIPOPEN=") && valid(mux)) {
+          open(mux);
+          reply("\r\nOK\r\n\r\n+CIPOPEN: %ld,0\r\n", mux);
+        } else if (startsWith(cmd, "+CIPSEND=") && valid(mux) &&
+                   a.size() > 1) {
+          startSend(mux, a[1], 1500, "\r\n> ");
+        } else if (startsWith(cmd, "+CIPRXGET=2,") && a.size() > 2 &&
+                   valid(a[1])) {
+          readCipRxGet(a[1], a[2], 1500);
+        } else if (startsWith(cmd, "+CIPRXGET=3,") && a.size() > 2 &&
+                   valid(a[1])) {
+          readCipRxGet(a[1], a[2], 1500, true);
+        } else if (startsWith(cmd, "+CIPRXGET=4,") && a.size() > 1 &&
+                   valid(a[1])) {
+          reply("\r\n+CIPRXGET: 4,%ld,%ld\r\n\r\nOK\r\n", a[1],
+                static_cast<long>(_sockets[a[1]].rx.size()));
+        } else if (startsWith(cmd, "+CIPCLOSE?")) {
+          _out += "\r\n+CIPCLOSE: ";
+          for (uint8_t i = 0; i < 10; i++) {
+            _out += _sockets[i].connected ? '1' : '0';
+            _out += i < 9 ? "," : "\r\n\r\nOK\r\n";
+          }
+        } else if (startsWith(cmd, "+CIPCLOSE=") && valid(mux)) {
+          _sockets[mux].connected = false;
+          reply("\r\nOK\r\n\r\n+CIPCLOSE: %ld,0\r\n", mux);
+        } else {
+          return false;
+        }
+        return true;
+
+      case BG96:
+        if (startsWith(cmd, "+QIOPEN=") && a.size() > 6 && valid(a[1]) &&
+            a.back() == 2) {
+          // Transparent access mode
+          open(a[1]);
+          enterDataMode(a[1]);
+        } else if (startsWith(cmd, "+QIOPEN=") && a.size() > 1 &&
+                   valid(a[1]) && _refuse) {
+          reply("\r\nOK\r\n\r\n+QIOPEN: %ld,566\r\n", a[1]);
+        } else if (startsWith(cmd, "+QIOPEN=") && a.size() > 1 &&
+                   valid(a[1])) {
+          open(a[1], cmd.find("UDP SERVICE") != std::string::npos);
+          reply("\r\nOK\r\n\r\n+QIOPEN: %ld,0\r\n", a[1]);
+        } else if (startsWith(cmd, "+QISWTMD=") && valid(mux) &&
+                   _sockets[mux].connected) {
+          enterDataMode(mux);
+        } else if (startsWith(cmd, "+QISEND=") && valid(mux) &&
+                   a.size() > 1) {
+          startSend(mux, a[1], 1460, "\r\n> ");
+        } else if (startsWith(cmd, "+QIRD=") && valid(mux) && a.size() > 1) {
+          Socket& s = _sockets[mux];
+          if (a[1] == 0) {
+            reply("\r\n+QIRD: %ld,%ld,%ld\r\n\r\nOK\r\n",
+                  static_cast<long>(s.read + s.rx.size()),
+                  static_cast<long>(s.read), static_cast<long>(s.rx.size()));
+          } else if (s.udp) {
+            size_t n = simMin(a[1], nextDatagram(s));
+            reply("\r\n+QIRD: %ld,\"10.0.0.2\",5000\r\n",
+                  static_cast<long>(n));
+            takeDatagram(s, n);
+            _out += "\r\n\r\nOK\r\n";
+          } else {
+            size_t n = simMin(simMin(a[1], 1500), s.rx.size());
+            reply("\r\n+QIRD: %ld\r\n", static_cast<long>(n));
+            take(s, n);
+            _out += "\r\n\r\nOK\r\n";
+          }
+        } else if (startsWith(cmd, "+QISTATE=1,") && a.size() > 1 &&
+                   valid(a[1])) {
+          if (_sockets[a[1]].connected) {
+            reply("\r\n+QISTATE: %ld,\"TCP\",\"10.0.0.1\",80,5087,2,1,%ld,0,"
+                  "\"uart1\"\r\n",
+                  a[1], a[1]);
+          }
+          _out += "\r\nOK\r\n";
+        } else if (cmd == "+QISTATE?") {
+          for (uint8_t i = 0; i < MUX_COUNT; i++) {
+            if (!_sockets[i].connected) { continue; }
+            char line[80];
+            snprintf(line, sizeof(line),
+                     "\r\n+QISTATE: %u,\"TCP\",\"10.0.0.1\",80,5087,2,1,%u,0,"
+                     "\"uart1\"",
+                     i, i);
+            _out += line;
+          }
+          _out += "\r\n\r\nOK\r\n";
+        } else if (startsWith(cmd, "+QICLOSE=") && valid(mux)) {
+          _sockets[mux].connected = false;
+          _out += "\r\nOK\r\n";
+        } else {
+          return false;
+        }
+        return true;
+
+      case UBLOX:
+        if (startsWith(cmd, "+USOCR=")) {
+          long free = -1;
+          for (uint8_t i = 0; i < MUX_COUNT && free < 0; i++) {
+            if (!_sockets[i].connected) { free = i; }
+          }
+          if (free < 0) {
+            _out += "\r\nERROR\r\n";
+          } else {
+            // A UDP socket (protocol 17) is ready as soon as it is made
+            if (mux == 17) { open(free, true); }
+            reply("\r\n+USOCR: %ld\r\n\r\nOK\r\n", free);
+          }
+        } else if (startsWith(cmd, "+USOCO=") && valid(mux) && _refuse) {
+          // Synchronously an ERROR; asynchronously a failing URC
+          if (a.size() > 3 && a.back() == 1) {
+            reply("\r\nOK\r\n\r\n+UUSOCO: %ld,1\r\n", mux);
+          } else {
+            _out += "\r\nERROR\r\n";
+          }
+        } else if (startsWith(cmd, "+USOCO=") && valid(mux)) {
+          open(mux);
+          _out += "\r\nOK\r\n";
+          // The asynchronous form reports the result in a URC
+          if (a.size() > 3 && a.back() == 1) {
+            reply("\r\n+UUSOCO: %ld,0\r\n", mux);
+          }
+        } else if (startsWith(cmd, "+USODL=") && valid(mux) &&
+                   _sockets[mux].connected) {
+          enterDataMode(mux);
+        } else if (startsWith(cmd, "+USOWR=") && valid(mux) && a.size() > 1) {
+          startSend(mux, a[1], 1024, "\r\n@");
+        } else if (startsWith(cmd, "+USOST=") && valid(mux) && a.size() > 3) {
+          startSend(mux, a[3], 1024, "\r\n@");
+          _sendTo = true;
+        } else if (startsWith(cmd, "+USORF=") && valid(mux) && a.size() > 1) {
+          Socket& s = _sockets[mux];
+          if (a[1] == 0) {
+            reply("\r\n+USORF: %ld,%ld\r\n\r\nOK\r\n", mux,
+                  static_cast<long>(s.rx.size()));
+          } else {
+            size_t n = simMin(a[1], nextDatagram(s));
+            reply("\r\n+USORF: %ld,\"10.0.0.2\",5000,%ld,\"", mux,
+                  static_cast<long>(n));
+            takeDatagram(s, n);
+            _out += "\"\r\n\r\nOK\r\n";
+          }
+        } else if (startsWith(cmd, "+USORD=") && valid(mux) && a.size() > 1) {
+          Socket& s = _sockets[mux];
+          if (a[1] == 0) {
+            reply("\r\n+USORD: %ld,%ld\r\n\r\nOK\r\n", mux,
+                  static_cast<long>(s.rx.size()));
+          } else {
+            size_t n = simMin(simMin(a[1], 1024), s.rx.size());
+            reply("\r\n+USORD: %ld,%ld,\"", mux, static_cast<long>(n));
+            take(s, n);
+            _out += "\"\r\n\r\nOK\r\n";
+          }
+        } else if (startsWith(cmd, "+USOCTL=") && valid(mux)) {
+          reply("\r\n+USOCTL: %ld,10,%ld\r\n\r\nOK\r\n", mux,
+                _sockets[mux].connected ? 4 : 0);
+        } else if (startsWith(cmd, "+USOCL=") && valid(mux)) {
+          _sockets[mux].connected = false;
+          _out += "\r\nOK\r\n";
+        } else {
+          return false;
+        }
+        return true;
+
+      case ESP8266:
+        if (startsWith(cmd, "+CIPSTART=") && valid(mux)) {
+          open(mux);
+          reply("%ld,CONNECT\r\n\r\nOK\r\n", mux);
+        } else if (startsWith(cmd, "+CIPSEND=") && valid(mux) &&
+                   a.size() > 1) {
+          startSend(mux, a[1], 2048, "\r\nOK\r\n> ");
+        } else if (cmd == "+CIPSTATUS") {
+          std::string list;
+          for (uint8_t i = 0; i < MUX_COUNT; i++) {
+            if (!_sockets[i].connected) { continue; }
+            char line[64];
+            snprintf(line, sizeof(line),
+                     "+CIPSTATUS:%u,\"TCP\",\"10.0.0.1\",80,1234,0\r\n", i);
+            list += line;
+          }
+          _out += list.empty() ? "STATUS:4\r\n" : "STATUS:3\r\n";
+          _out += list + "\r\nOK\r\n";
+        } else if (startsWith(cmd, "+CIPCLOSE=") && valid(mux)) {
+          _sockets[mux].connected = false;
+          reply("%ld,CLOSED\r\n\r\nOK\r\n", mux);
+        } else {
+          return false;
+        }
+        return true;
+    }
+    return false;
+  }
+
+  bool valid(long mux) const {
+    return mux >= 0 && mux < MUX_COUNT;
+  }
+
+  void open(long mux, bool udp = false) {
+    _sockets[mux]           = Socket();
+    _sockets[mux].connected = true;
+    _sockets[mux].udp       = udp;
+    _lastOpened             = static_cast<int8_t>(mux);
+  }
+
+  // The size of the first datagram waiting on a UDP socket
+  size_t nextDatagram(const Socket& s) const {
+    return s.datagrams.empty() ? 0 : s.datagrams.front();
+  }
+
+  // Moves the first n bytes of the first datagram out, dropping the rest of
+  // it as the modems do
+  void takeDatagram(Socket& s, size_t n) {
+    size_t len = nextDatagram(s);
+    take(s, n);
+    s.rx.erase(0, len - n);
+    if (!s.datagrams.empty()) { s.datagrams.erase(s.datagrams.begin()); }
+  }
+
+  // +CIPRXGET: 2,<mux>,<read>,<left>, followed by the data and OK, or with
+  // mode 3 the same with the data as two HEX digits a byte (of which the
+  // modem gives half as many).  Asking for more than that is an ERROR.  A
+  // UDP socket gives one datagram at a time.
+  void readCipRxGet(long mux, long size, size_t maxLen, bool hex = false) {
+    if (hex) { maxLen /= 2; }
+    if (size < 1 || static_cast<size_t>(size) > maxLen) {
+      _out += "\r\nERROR\r\n";
+      return;
+    }
+    Socket& s     = _sockets[mux];
+    size_t  avail = s.udp ? nextDatagram(s) : s.rx.size();
+    size_t  n     = simMin(size, avail);
+    reply("\r\n+CIPRXGET: %ld,%ld,%ld,", hex ? 3 : 2, mux,
+          static_cast<long>(n));
+    reply("%ld\r\n", static_cast<long>(s.rx.size() - n));
+    size_t start = _out.size();
+    if (s.udp) {
+      takeDatagram(s, n);
+    } else {
+      take(s, n);
+    }
+    if (hex) {
+      std::string data = _out.substr(start);
+      _out.resize(start);
+      for (size_t i = 0; i < data.size(); i++) {
+        reply("%02lX", static_cast<uint8_t>(data[i]));
+      }
+    }
+    _out += "\r\nOK\r\n";
+  }
+
+  // Moves n bytes of a socket's buffer out to the library
+  void take(Socket& s, size_t n) {
+    _out.append(s.rx, 0, n);
+    s.rx.erase(0, n);
+    s.read += n;
+  }
+
+  // Refuses more than the modem takes in one send, as the real ones do
+  void startSend(long mux, long len, long maxLen, const char* prompt) {
+    if (len > maxLen) {
+      _out += "\r\nERROR\r\n";
+      return;
+    }
+    _sendMux = static_cast<uint8_t>(mux);
+    _sendLen = len;
+    _sendBuf.clear();
+    _out += prompt;
+  }
+
+  void finishSend() {
+    Socket& s = _sockets[_sendMux];
+    s.tx += _sendBuf;
+    long len = _sendLen;
+    _sendLen = -1;
+    _sendBuf.clear();
+    switch (_dialect) {
+      case SIM800: reply("\r\nDATA ACCEPT:%ld,%ld\r\n", _sendMux, len); break;
+      case SIM7600:
+        reply("\r\nOK\r\n\r\n+CIPSEND: %ld,%ld,%ld\r\n", _sendMux, len, len);
+        break;
+      case BG96: _out += "\r\nSEND OK\r\n"; break;
+      case UBLOX:
+        reply(_sendTo ? "\r\n+USOST: %ld,%ld\r\n\r\nOK\r\n"
+                      : "\r\n+USOWR: %ld,%ld\r\n\r\nOK\r\n",
+              _sendMux, len);
+        _sendTo = false;
+        break;
+      case ESP8266: reply("\r\nRecv %ld bytes\r\n\r\nSEND OK\r\n", len); break;
+    }
+  }
+
+  Dialect                                          _dialect;
+  std::string                                      _out;
+  size_t                                           _outPos;
+  std::string                                      _line;
+  uint8_t                                          _sendMux;
+  long                                             _sendLen;
+  bool                                             _sendTo;  // +USOST
+  bool                                             _skipLf;
+  std::string                                      _sendBuf;
+  Socket                                           _sockets[MUX_COUNT];
+  std::vector<std::pair<std::string, std::string>> _rules;
+  uint32_t                                         _commands;
+  uint32_t                                         _lookups;
+  bool                                             _refuse;
+  std::string                                      _lastCommand;
+  int8_t                                           _lastOpened;
+  int8_t                                           _dataMux;  // Or -1
+  uint8_t                                          _plus;  // Of an escape
+  uint32_t                                         _lastData;
+};
+
+#endif  // HOST_MODEMSIMULATOR_H_
@@ -0,0 +1,97 @@
+/**
+ * @file       Print.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Host stand-in for the Arduino Print class.
+ */
+
+#ifndef HOST_PRINT_H_
+#define HOST_PRINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Printable.h"
+#include "WString.h"
+
+class Print {
+ public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      if (!write(*buffer++)) break;
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char* str) {
+    if (str == NULL) return 0;
+    return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+  }
+  size_t write(const char* buffer, size_t size) {
+    return write(reinterpret_cast<const uint8_t*>(buffer), size);
+  }
+  virtual int availableForWrite() {
+    return 0;
+  }
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper* s) {
+    return write(reinterpret_cast<const char*>(s));
+  }
+  size_t print(const String& s) {
+    return write(s.c_str(), s.length());
+  }
+  size_t print(const char* s) {
+    return write(s);
+  }
+  size_t print(char c) {
+    return write(static_cast<uint8_t>(c));
+  }
+  size_t print(unsigned char n, int base = DEC) {
+    return print(static_cast<unsigned long>(n), base);
+  }
+  size_t print(int n, int base = DEC) {
+    return print(static_cast<long>(n), base);
+  }
+  size_t print(unsigned int n, int base = DEC) {
+    return print(static_cast<unsigned long>(n), base);
+  }
+  size_t print(long n, int base = DEC) {
+    if (base == 0) return write(static_cast<uint8_t>(n));
+    return print(String(n, static_cast<unsigned char>(base)));
+  }
+  size_t print(unsigned long n, int base = DEC) {
+    if (base == 0) return write(static_cast<uint8_t>(n));
+    return print(String(n, static_cast<unsigned char>(base)));
+  }
+  size_t print(double n, int digits = 2) {
+    return print(String(n, static_cast<unsigned char>(digits)));
+  }
+  size_t print(const Printable& x) {
+    return x.printTo(*this);
+  }
+
+  size_t println() {
+    return write("\r\n");
+  }
+  template <typename T>
+  size_t println(T x) {
+    size_t n = print(x);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(T x, int fmt) {
+    size_t n = print(x, fmt);
+    return n + println();
+  }
+};
+
+#endif  // HOST_PRINT_H_
@@ -0,0 +1,24 @@
+/**
+ * @file       Printable.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Host stand-in for the Arduino Printable interface.
+ */
+
+#ifndef HOST_PRINTABLE_H_
+#define HOST_PRINTABLE_H_
+
+#include <stddef.h>
+
+class Print;
+
+class Printable {
+ public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif  // HOST_PRINTABLE_H_
@@ -0,0 +1,156 @@
+/**
+ * @file       Stream.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Host stand-in for the Arduino Stream class, including the timed parsing
+ * helpers (readBytes, readStringUntil, parseInt, ...) that TinyGSM uses.
+ */
+
+#ifndef HOST_STREAM_H_
+#define HOST_STREAM_H_
+
+#include "Print.h"
+
+unsigned long millis();
+
+class Stream : public Print {
+ public:
+  Stream() : _timeout(1000) {}
+
+  virtual int available() = 0;
+  virtual int read()      = 0;
+  virtual int peek()      = 0;
+
+  void setTimeout(unsigned long timeout) {
+    _timeout = timeout;
+  }
+  unsigned long getTimeout() {
+    return _timeout;
+  }
+
+  bool find(const char* target) {
+    size_t len   = strlen(target);
+    size_t index = 0;
+    if (!len) return true;
+    int c;
+    while ((c = timedRead()) >= 0) {
+      if (c == target[index]) {
+        if (++index >= len) return true;
+      } else {
+        index = (c == target[0]) ? 1 : 0;
+      }
+    }
+    return false;
+  }
+
+  long parseInt() {
+    bool isNegative = false;
+    long value      = 0;
+    int  c          = peekNextDigit(false);
+    if (c < 0) return 0;
+    do {
+      if (c == '-') {
+        isNegative = true;
+      } else if (c >= '0' && c <= '9') {
+        value = value * 10 + c - '0';
+      }
+      read();
+      c = timedPeek();
+    } while (c >= '0' && c <= '9');
+    return isNegative ? -value : value;
+  }
+
+  float parseFloat() {
+    String s;
+    int    c = peekNextDigit(true);
+    if (c < 0) return 0;
+    do {
+      s += static_cast<char>(c);
+      read();
+      c = timedPeek();
+    } while ((c >= '0' && c <= '9') || c == '.');
+    return s.toFloat();
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+      int c = timedRead();
+      if (c < 0) break;
+      *buffer++ = static_cast<char>(c);
+      count++;
+    }
+    return count;
+  }
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    return readBytes(reinterpret_cast<char*>(buffer), length);
+  }
+
+  size_t readBytesUntil(char terminator, char* buffer, size_t length) {
+    size_t index = 0;
+    while (index < length) {
+      int c = timedRead();
+      if (c < 0 || c == terminator) break;
+      *buffer++ = static_cast<char>(c);
+      index++;
+    }
+    return index;
+  }
+
+  String readString() {
+    String ret;
+    int    c = timedRead();
+    while (c >= 0) {
+      ret += static_cast<char>(c);
+      c = timedRead();
+    }
+    return ret;
+  }
+
+  String readStringUntil(char terminator) {
+    String ret;
+    int    c = timedRead();
+    while (c >= 0 && c != terminator) {
+      ret += static_cast<char>(c);
+      c = timedRead();
+    }
+    return ret;
+  }
+
+ protected:
+  int timedRead() {
+    unsigned long start = millis();
+    do {
+      int c = read();
+      if (c >= 0) return c;
+    } while (millis() - start < _timeout);
+    return -1;
+  }
+
+  int timedPeek() {
+    unsigned long start = millis();
+    do {
+      int c = peek();
+      if (c >= 0) return c;
+    } while (millis() - start < _timeout);
+    return -1;
+  }
+
+  int peekNextDigit(bool allowDecimal) {
+    for (;;) {
+      int c = timedPeek();
+      if (c < 0 || c == '-' || (c >= '0' && c <= '9') ||
+          (allowDecimal && c == '.')) {
+        return c;
+      }
+      read();
+    }
+  }
+
+  unsigned long _timeout;
+};
+
+#endif  // HOST_STREAM_H_
@@ -0,0 +1,17 @@
+/**
+ * @file       Udp.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Host stand-in for the Arduino UDP class; reuses the library's own copy.
+ */
+
+#ifndef HOST_UDP_H_
+#define HOST_UDP_H_
+
+#include "Arduino.h"
+#include <ArduinoCompat/Udp.h>
+
+#endif  // HOST_UDP_H_
@@ -0,0 +1,354 @@
+/**
+ * @file       WString.h
+ * @author     Volodymyr Shymanskyy
+ * @license    LGPL-3.0
+ * @copyright  Copyright (c) 2016 Volodymyr Shymanskyy
+ * @date       Nov 2016
+ *
+ * Host stand-in for the Arduino String class, backed by std::string.  Only
+ * the parts of the API that TinyGSM and its examples use are provided.
+ */
+
+#ifndef HOST_WSTRING_H_
+#define HOST_WSTRING_H_
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+class __FlashStringHelper;
+#define F(string_literal) \
+  (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class String {
+ public:
+  String(const char* cstr = "") : _s(cstr ? cstr : "") {}
+  String(const String& str) : _s(str._s) {}
+  explicit String(const __FlashStringHelper* str)
+      : _s(reinterpret_cast<const char*>(str)) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10) {
+    fromULong(value, base);
+  }
+  explicit String(int value, unsigned char base = 10) {
+    fromLong(value, base);
+  }
+  explicit String(unsigned int value, unsigned char base = 10) {
+    fromULong(value, base);
+  }
+  explicit String(long value, unsigned char base = 10) {
+    fromLong(value, base);
+  }
+  explicit String(unsigned long value, unsigned char base = 10) {
+    fromULong(value, base);
+  }
+  explicit String(float value, unsigned char decimalPlaces = 2) {
+    fromDouble(value, decimalPlaces);
+  }
+  explicit String(double value, unsigned char decimalPlaces = 2) {
+    fromDouble(value, decimalPlaces);
+  }
+
+  String& operator=(const String& rhs) {
+    _s = rhs._s;
+    return *this;
+  }
+  String& operator=(const char* cstr) {
+    _s = cstr ? cstr : "";
+    return *this;
+  }
+
+  unsigned char reserve(unsigned int size) {
+    _s.reserve(size);
+    return 1;
+  }
+  unsigned int length() const {
+    return _s.length();
+  }
+  const char* c_str() const {
+    return _s.c_str();
+  }
+
+  // concatenation
+  unsigned char concat(const String& str) {
+    _s += str._s;
+    return 1;
+  }
+  unsigned char concat(const char* cstr) {
+    if (cstr) _s += cstr;
+    return 1;
+  }
+  unsigned char concat(const __FlashStringHelper* str) {
+    return concat(reinterpret_cast<const char*>(str));
+  }
+  unsigned char concat(char c) {
+    _s += c;
+    return 1;
+  }
+  unsigned char concat(unsigned char num) {
+    return concat(String(num));
+  }
+  unsigned char concat(int num) {
+    return concat(String(num));
+  }
+  unsigned char concat(unsigned int num) {
+    return concat(String(num));
+  }
+  unsigned char concat(long num) {
+    return concat(String(num));
+  }
+  unsigned char concat(unsigned long num) {
+    return concat(String(num));
+  }
+  unsigned char concat(float num) {
+    return concat(String(num));
+  }
+  unsigned char concat(double num) {
+    return concat(String(num));
+  }
+  template <typename T>
+  String& operator+=(T rhs) {
+    concat(rhs);
+    return *this;
+  }
+  String& operator+=(signed char rhs) {
+    concat(static_cast<int>(rhs));
+    return *this;
+  }
+
+  // comparison
+  bool equals(const String& s) const {
+    return _s == s._s;
+  }
+  bool equals(const char* cstr) const {
+    return _s == (cstr ? cstr : "");
+  }
+  bool operator==(const String& rhs) const {
+    return equals(rhs);
+  }
+  bool operator==(const char* cstr) const {
+    return equals(cstr);
+  }
+  bool operator!=(const String& rhs) const {
+    return !equals(rhs);
+  }
+  bool operator!=(const char* cstr) const {
+    return !equals(cstr);
+  }
+  bool operator<(const String& rhs) const {
+    return _s < rhs._s;
+  }
+  bool startsWith(const String& prefix) const {
+    return _s.compare(0, prefix._s.length(), prefix._s) == 0;
+  }
+  bool startsWith(const String& prefix, unsigned int offset) const {
+    return offset <= _s.length() &&
+           _s.compare(offset, prefix._s.length(), prefix._s) == 0;
+  }
+  bool endsWith(const String& suffix) const {
+    return _s.length() >= suffix._s.length() &&
+           _s.compare(_s.length() - suffix._s.length(), suffix._s.length(),
+                      suffix._s) == 0;
+  }
+
+  // character access
+  char charAt(unsigned int index) const {
+    return index < _s.length() ? _s[index] : 0;
+  }
+  void setCharAt(unsigned int index, char c) {
+    if (index < _s.length()) _s[index] = c;
+  }
+  char operator[](unsigned int index) const {
+    return charAt(index);
+  }
+  char& operator[](unsigned int index) {
+    return _s[index];
+  }
+  void getBytes(unsigned char* buf, unsigned int bufsize,
+                unsigned int index = 0) const {
+    if (!bufsize || !buf) return;
+    if (index >= _s.length()) {
+      buf[0] = 0;
+      return;
+    }
+    unsigned int n = bufsize - 1;
+    if (n > _s.length() - index) n = _s.length() - index;
+    memcpy(buf, _s.data() + index, n);
+    buf[n] = 0;
+  }
+  void toCharArray(char* buf, unsigned int bufsize,
+                   unsigned int index = 0) const {
+    getBytes(reinterpret_cast<unsigned char*>(buf), bufsize, index);
+  }
+
+  // search
+  int indexOf(char ch, unsigned int fromIndex = 0) const {
+    return toIndex(_s.find(ch, fromIndex));
+  }
+  int indexOf(const String& str, unsigned int fromIndex = 0) const {
+    return toIndex(_s.find(str._s, fromIndex));
+  }
+  int lastIndexOf(char ch) const {
+    return toIndex(_s.rfind(ch));
+  }
+  int lastIndexOf(char ch, unsigned int fromIndex) const {
+    return toIndex(_s.rfind(ch, fromIndex));
+  }
+  int lastIndexOf(const String& str) const {
+    return toIndex(_s.rfind(str._s));
+  }
+  int lastIndexOf(const String& str, unsigned int fromIndex) const {
+    return toIndex(_s.rfind(str._s, fromIndex));
+  }
+  String substring(unsigned int beginIndex) const {
+    return substring(beginIndex, _s.length());
+  }
+  String substring(unsigned int left, unsigned int right) const {
+    if (left > right) {
+      unsigned int t = left;
+      left           = right;
+      right          = t;
+    }
+    if (left >= _s.length()) return String();
+    if (right > _s.length()) right = _s.length();
+    return String(_s.substr(left, right - left).c_str());
+  }
+
+  // modification
+  void replace(char find, char replace) {
+    for (size_t i = 0; i < _s.length(); i++) {
+      if (_s[i] == find) _s[i] = replace;
+    }
+  }
+  void replace(const String& find, const String& replace) {
+    if (!find._s.length()) return;
+    size_t pos = 0;
+    while ((pos = _s.find(find._s, pos)) != std::string::npos) {
+      _s.replace(pos, find._s.length(), replace._s);
+      pos += replace._s.length();
+    }
+  }
+  void remove(unsigned int index) {
+    if (index < _s.length()) _s.erase(index);
+  }
+  void remove(unsigned int index, unsigned int count) {
+    if (index < _s.length()) _s.erase(index, count);
+  }
+  void toLowerCase() {
+    for (size_t i = 0; i < _s.length(); i++) _s[i] = tolower(_s[i]);
+  }
+  void toUpperCase() {
+    for (size_t i = 0; i < _s.length(); i++) _s[i] = toupper(_s[i]);
+  }
+  void trim() {
+    size_t b = 0;
+    size_t e = _s.length();
+    while (b < e && isspace(static_cast<unsigned char>(_s[b]))) b++;
+    while (e > b && isspace(static_cast<unsigned char>(_s[e - 1]))) e--;
+    _s = _s.substr(b, e - b);
+  }
+
+  // parsing/conversion
+  long toInt() const {
+    return atol(_s.c_str());
+  }
+  float toFloat() const {
+    return static_cast<float>(atof(_s.c_str()));
+  }
+  double toDouble() const {
+    return atof(_s.c_str());
+  }
+
+ private:
+  static int toIndex(size_t pos) {
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+  }
+  void fromULong(unsigned long value, unsigned char base) {
+    char buf[8 * sizeof(long) + 1];
+    char* p = &buf[sizeof(buf) - 1];
+    *p      = '\0';
+    if (base < 2) base = 10;
+    do {
+      unsigned long d = value % base;
+      *--p            = d < 10 ? '0' + d : 'A' + d - 10;
+      value /= base;
+    } while (value);
+    _s = p;
+  }
+  void fromLong(long value, unsigned char base) {
+    if (value < 0 && base == 10) {
+      fromULong(static_cast<unsigned long>(-value), base);
+      _s.insert(_s.begin(), '-');
+    } else {
+      fromULong(static_cast<unsigned long>(value), base);
+    }
+  }
+  void fromDouble(double value, unsigned char decimalPlaces) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+    _s = buf;
+  }
+
+  std::string _s;
+};
+
+inline String operator+(const String& lhs, const String& rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, const char* rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const char* lhs, const String& rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, char rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, int rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, unsigned int rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, long rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, unsigned long rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, float rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+inline String operator+(const String& lhs, double rhs) {
+  String s(lhs);
+  s += rhs;
+  return s;
+}
+
+#endif  // HOST_WSTRING_H_
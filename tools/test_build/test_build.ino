@@ -4,7 +4,14 @@
  *  This is NOT an example for use of this library!
  *
  **************************************************************/
+// Build the opt-in queued AT commands as well
+#define TINY_GSM_ASYNC
+
 #include <TinyGsmClient.h>
+#include <TinyGsmCmux.h>
+#if defined(ESP32) && defined(CONFIG_LWIP_PPP_SUPPORT)
+#include <TinyGsmPPP.h>
+#endif
 
 TinyGsm modem(Serial);
 
@@ -42,6 +49,21 @@ void loop() {
   modem.getLocalIP();
   modem.localIP();
 
+// Test the asynchronous AT commands
+#if defined(TINY_GSM_MODEM_HAS_ASYNC)
+  modem.queueAT(F("+CSQ"));
+  modem.queueAT("+CGATT=1", NULL, NULL, 75000L);
+  while (modem.poll()) {}
+  modem.pendingAT();
+#endif
+
+// Test batching XBee settings into one command mode session
+#if defined(TINY_GSM_MODEM_XBEE)
+  modem.beginConfig();
+  modem.getSignalQuality();
+  modem.commitConfig();
+#endif
+
 // Test the GPRS and SIM card functions
 #if defined(TINY_GSM_MODEM_HAS_GPRS)
   modem.simUnlock("1234");
@@ -74,13 +96,29 @@ void loop() {
   char server[]   = "somewhere";
   char resource[] = "something";
 
+#if defined(TINY_GSM_MODEM_HAS_DNS)
+  // Test the DNS cache
+  static const char* const hosts[] = {server, "elsewhere"};
+  modem.prefetch(hosts, 2);
+  modem.resolve(server);
+  modem.clearDnsCache(server);
+#endif
+
   client.connect(server, 80);
+#if defined(TINY_GSM_MODEM_HAS_CONNECT_ASYNC)
+  client2.connectAsync(server, 80);
+  while (client2.connecting()) {}
+#endif
 
   // Make a HTTP GET request:
   client.print(String("GET ") + resource + " HTTP/1.0\r\n");
   client.print(String("Host: ") + server + "\r\n");
   client.print("Connection: close\r\n\r\n");
 
+  static const char body[] TINY_GSM_PROGMEM = "body";
+  client.writeFrom(reinterpret_cast<const uint8_t*>(body), 4);
+  client.writeFrom(Serial, 4);
+
   uint32_t timeout = millis();
   while (client.connected() && millis() - timeout < 10000L) {
     while (client.available()) {
@@ -88,9 +126,65 @@ void loop() {
       timeout = millis();
     }
   }
+  client.readTo(Serial, 1024, 1000L);
+  modem.pollSockets(0x03, 1000L);
+  modem.nextReadySocket();
 
   client.stop();
 
+#if defined(TINY_GSM_MODEM_HAS_UDP)
+  // Test UDP functions
+  TinyGsmClientUDP udp(modem, 2);
+  udp.begin(8888);
+  udp.beginPacket(server, 123);
+  udp.write(reinterpret_cast<const uint8_t*>(resource), 4);
+  udp.endPacket();
+  if (udp.parsePacket()) {
+    udp.remoteIP();
+    udp.remotePort();
+    udp.read();
+  }
+  udp.stop();
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_CMUX)
+  // Test the multiplexer
+  TinyGsmCmux cmux(Serial);
+  cmux.begin();
+  TinyGsm modem_mux(cmux.channel(1));
+  modem_mux.testAT();
+  cmux.channel(2).read();
+  cmux.errors();
+  cmux.end();
+#endif
+
+#if defined(SRC_TINYGSMPPP_H_)
+  // Test PPP functions
+  TinyGsmPPP ppp(Serial);
+  ppp.begin("YourAPN", "", "");
+  TinyGsmPPP::Client client_ppp(ppp);
+  client_ppp.connect(server, 80);
+  client_ppp.write(reinterpret_cast<const uint8_t*>(resource), 4);
+  client_ppp.read();
+  client_ppp.stop();
+  ppp.loop();
+  ppp.localIP();
+  ppp.end();
+#endif
+
+#if defined(TINY_GSM_MODEM_HAS_TRANSPARENT)
+  // Test transparent (data mode) functions
+  TinyGsmClientTransparent client_data(modem, 3);
+  client_data.connect(server, 80);
+  client_data.write(reinterpret_cast<const uint8_t*>(resource), 4);
+  client_data.writeFrom(Serial, 4);
+  client_data.readTo(Serial, 16, 1000);
+  client_data.commandMode();
+  client_data.dataMode();
+  client_data.read();
+  client_data.stop();
+#endif
+
 #if defined(TINY_GSM_MODEM_HAS_SSL)
   // modem.addCertificate();  // not yet impemented
   // modem.deleteCertificate();  // not yet impemented